@@ -24,8 +24,8 @@ namespace hh::ansi {
     template<typename... Args>
     code_t(char ch, Args... args) -> code_t<sizeof...(args), Args...>;
 
-    template<class T, std::size_t N, typename... Args>
-    shell::oserial_stream<T> &operator<<(shell::oserial_stream<T> &os, const code_t<N, Args...> &code) {
+    template<class T, class Lock, std::size_t N, typename... Args>
+    shell::oserial_stream<T, Lock> &operator<<(shell::oserial_stream<T, Lock> &os, const code_t<N, Args...> &code) {
         os << "\x1b[";
         if constexpr (N > 0) {
             for (std::size_t i = 0; i < N; ++i) {
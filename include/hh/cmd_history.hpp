@@ -1,17 +1,28 @@
 /// \file cmd_history.hpp
-/// \brief Created on 2021-09-01 by Ben
-/// \todo Add documentation
+/// \brief A history of the lines entered in the shell, packed into a fixed size ring
 
 #pragma once
+#include <algorithm>
+#include <compare>
+#include <cstdint>
 #include <cstring>
+#include <hh/ring_buffer.hpp>
+#include <iterator>
+#include <limits>
 #include <string_view>
+#include <type_traits>
+
 namespace hh::shell {
 
-    template<std::size_t NumLines, std::size_t LineLen>
+    template<std::size_t NumLines, std::size_t LineLen, std::size_t IndexSize = 0>
     class cmd_history;
 
-    // todo add pointer to member parameter for inc and dec functions
-    template<class T, class Container>
+    /// \brief A random access iterator over the lines of a history, from the oldest line to the newest
+    ///
+    /// Iterators hold the number of a line, so they stay on it while other lines are added or erased.
+    /// Incrementing and decrementing skip the numbers of erased lines, while adding an offset moves over line
+    /// numbers in constant time, through the history's table, and may land on an erased line, which is empty.
+    template<class Container>
     class circular_iter {
     public:
         struct string_view_ptr : public std::string_view {
@@ -20,28 +31,28 @@ namespace hh::shell {
             }
         };
 
-        using iterator_category = std::bidirectional_iterator_tag;
-        using value_type = typename std::remove_const<T>;
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = std::string_view;
         using difference_type = std::ptrdiff_t;
         using reference = std::string_view;
         using pointer = string_view_ptr;
 
-        circular_iter(T item, Container *container)
-            : pos_(item), container_(container) {}
+        circular_iter() = default;
+
+        circular_iter(std::size_t number, Container *container)
+            : number_(number), container_(container) {}
 
-        template<class OtherT, class OtherContainer>
-        requires std::is_convertible_v<T *, OtherT *>
-        circular_iter(const circular_iter<OtherT, OtherContainer> &other)
-            : pos_(other.pos_), container_(other.container_) {}
+        /// \brief The line, or an empty line for the end iterator and erased lines
+        reference operator*() const { return container_ == nullptr ? reference{} : container_->at(number_); }
+        pointer operator->() const { return pointer{**this}; }
+        reference operator[](difference_type n) const { return *(*this + n); }
 
-        reference operator*() { return pos_; }
-        pointer operator->() { return pointer{pos_}; }
+        /// \brief The number of the line, as listed by the shell's `history` command
+        [[nodiscard]] std::size_t number() const { return number_; }
 
-        /// \brief Increments to next string in buffer
-        /// \return
+        /// \brief Increments to the next newer line
         circular_iter &operator++() {
-            container_->increment(pos_);
-            if (pos_ == container_->tail_ || pos_ == container_->head_) { pos_ = nullptr; }
+            do { ++number_; } while (number_ < container_->end_number() && !container_->holds(number_));
             return *this;
         }
 
@@ -51,9 +62,9 @@ namespace hh::shell {
             return old;
         }
 
+        /// \brief Decrements to the next older line, or the newest line from the end iterator
         circular_iter &operator--() {
-            if (pos_ == nullptr) { pos_ = container_->head_; }
-            container_->decrement(pos_);
+            do { --number_; } while (!container_->holds(number_));
             return *this;
         }
 
@@ -63,102 +74,392 @@ namespace hh::shell {
             return old;
         }
 
-        bool operator==(const circular_iter &other) const { return pos_ == other.pos_; }
+        circular_iter &operator+=(difference_type n) {
+            number_ += static_cast<std::size_t>(n);
+            return *this;
+        }
+
+        circular_iter &operator-=(difference_type n) { return *this += -n; }
+
+        friend circular_iter operator+(circular_iter it, difference_type n) { return it += n; }
+        friend circular_iter operator+(difference_type n, circular_iter it) { return it += n; }
+        friend circular_iter operator-(circular_iter it, difference_type n) { return it -= n; }
+
+        friend difference_type operator-(const circular_iter &lhs, const circular_iter &rhs) {
+            return static_cast<difference_type>(lhs.number_ - rhs.number_);
+        }
+
+        bool operator==(const circular_iter &other) const { return number_ == other.number_; }
+        auto operator<=>(const circular_iter &other) const { return number_ <=> other.number_; }
 
     private:
-        T pos_;
-        Container *container_;
+        std::size_t number_{0};
+        Container *container_{nullptr};
     };
 
-    template<std::size_t NumLines, std::size_t LineLen>
+    /// \brief The most recently entered lines, packed into a fixed size ring
+    ///
+    /// Lines are stored as records of their length, their chars and a mask of the chars in them. A record is
+    /// never split across the end of the ring, the space left at the end is skipped instead, so each line can
+    /// be viewed in place. The oldest lines are only evicted when a new line does not fit.
+    ///
+    /// Lines are numbered from 1 in the order they are pushed, and keep their number while they are in the
+    /// history. A table of the offsets of the records, oldest first, finds a line by its number without
+    /// walking the ring. The ring and the table share the RAM of NumLines lines and their terminators: the table
+    /// takes an eighth of it, for up to 8 times NumLines lines, and the ring the rest. Its offsets take one byte
+    /// for histories of up to 255 bytes and two otherwise.
+    ///
+    /// Erasing a line marks its record as erased in place and leaves a hole in the table, so no other line
+    /// moves or is renumbered. The space of erased lines is reused once they become the oldest record. The ring
+    /// is only compacted once erased records take a quarter of it, so the cost of moving the lines is shared by
+    /// the many pushes that erased them, and until then the oldest lines are evicted to make space. With an
+    /// index, lines are
+    /// found by a hash of their chars when pushing a line already in the history, instead of comparing every
+    /// line.
+    /// \tparam NumLines The number of lines of the maximum length the RAM is sized for, shorter lines are packed
+    /// and up to 8 times as many of them fit. The table and the length and mask of each line take some of that
+    /// space, so fewer lines of the maximum length are kept.
+    /// \tparam LineLen The maximum length of a line, longer lines are cut short
+    /// \tparam IndexSize The number of slots in the hash index, a power of two, or 0 for no index. At most 3/4
+    /// of the slots are used, older lines are evicted to keep it that way.
+    template<std::size_t NumLines, std::size_t LineLen, std::size_t IndexSize>
     class cmd_history {
     public:
-        // todo pack strings in buffer
-        // todo copy/move constructors
+        static_assert(LineLen <= 255, "line lengths are stored in a byte");
+        static_assert(NumLines > 0, "the history needs space for at least one line");
+        static_assert((IndexSize & (IndexSize - 1)) == 0, "the index size must be a power of two");
+
         using value_type = char *;
         using reference = char *;
         using const_reference = std::string_view;
-        using const_iterator = circular_iter<const char *, const cmd_history>;
+        using const_iterator = circular_iter<const cmd_history>;
         using iterator = const_iterator;
         using difference_type = std::ptrdiff_t;
         using size_type = std::size_t;
 
-        cmd_history() = default;
+        cmd_history() {
+            static_assert(sizeof(cmd_history) <= std::max(lineBudget_, bufferSize_ + tableSize_ * sizeof(offset_type)) +
+                                  sizeof(index_) + 8 * sizeof(size_type),
+                          "the history takes the RAM of its lines and a few words");
+        }
+
+        // Lines are viewed in place
+        cmd_history(const cmd_history &) = delete;
+        cmd_history &operator=(const cmd_history &) = delete;
 
-        const_iterator begin() const { return const_iterator{tail_, this}; }
-        const_iterator end() const { return const_iterator{nullptr, this}; }
+        // The oldest entry of the table is always a line, erased lines are dropped from the front
+        const_iterator begin() const { return const_iterator{firstNumber_, this}; }
+        const_iterator end() const { return const_iterator{end_number(), this}; }
 
-        [[nodiscard]] const_reference front() const { return tail_; }
-        [[nodiscard]] const_reference back() const {
-            const char *pos = head_;
-            decrement(pos);
-            return pos;
+        /// \brief Finds a line by its number
+        /// \return The line, or `end()` if the line has been erased or evicted, or not pushed yet
+        [[nodiscard]] const_iterator find_number(size_type number) const {
+            return holds(number) ? const_iterator{number, this} : end();
         }
 
+        /// \brief The line numbered pos after the oldest, in constant time
+        /// \return The line, or an empty line if it has been erased
+        [[nodiscard]] const_reference operator[](size_type pos) const { return at(firstNumber_ + pos); }
+
+        [[nodiscard]] const_reference front() const { return *begin(); }
+        [[nodiscard]] const_reference back() const { return *--end(); }
+
         [[nodiscard]] bool empty() const { return size() == 0; }
-        [[nodiscard]] size_type size() const { return numCmds_; }
-        [[nodiscard]] size_type max_size() const { return NumLines; }
+        [[nodiscard]] size_type size() const { return numLines_; }
+        /// \brief The most lines the history can hold, limited by the space for empty lines and the index
+        [[nodiscard]] static constexpr size_type max_size() { return maxLines_; }
 
-        void erase(const_iterator pos) {
-            auto p = const_cast<char *>(pos->data());
+        /// \brief Marks a line as erased, leaving the records and numbers of the other lines as they are
+        void erase(const_iterator pos) { erase(record_of(pos.number())); }
 
-            if (p >= tail_) {
-                std::copy_backward(tail_, p, p + lineLen_);
-                increment(tail_);
-            } else {
-                std::copy(p + lineLen_, head_, p);
-                decrement(head_);
-            }
-        }
+        /// \brief Adds a line as the newest, moving it there if it is already in the history
+        /// \return false if the line was already the newest, and the history is unchanged
+        bool push_back(std::string_view line) {
+            const auto text = line.substr(0, LineLen);
+            const auto hash = hash_line(text);
 
-        void push_back(const char *line) {
+            if (auto duplicate = find(text, hash); duplicate != nullptr) {
+                if (offset(duplicate) == lines_[lines_.size() - 1]) { return false; }
+                erase(duplicate);
+            }
+            if constexpr (indexed_) {
+                while (size() >= maxIndexed_) { evict(); }
+            }
+            // Holes left by compaction take space in the table until they reach its front
+            while (lines_.full()) { evict(); }
 
-            for (auto it = begin(); it != end(); ++it) {
-                if (*it == line) {
-                    erase(it);
-                    break;
+            const auto size = record_size(text.size());
+            size_type pos;
+            while (!find_space(size, pos)) {
+                if (erasedBytes_ >= compact_threshold_) {
+                    compact();
+                } else {
+                    evict();
                 }
             }
 
-            std::strcpy(head_, line);
+            buffer_[pos] = static_cast<char>(text.size());
+            std::copy(text.begin(), text.end(), &buffer_[pos + 1]);
+            auto mask = char_mask(text);
+            std::memcpy(&buffer_[pos + 1 + text.size()], &mask, sizeof(mask));
+            head_ = pos + size;
+            ++numRecords_;
+            ++numLines_;
+            lines_.push(static_cast<offset_type>(pos));
+            index(&buffer_[pos], hash);
+            return true;
+        }
 
-            if (head_ == tail_ && !empty()) {
-                increment(tail_);
-            } else {
-                ++numCmds_;
+        /// \brief Finds the newest line that contains some text, searching from a line towards older lines
+        ///
+        /// Each line is stored with a mask of the chars in it, so most lines are rejected without being read.
+        /// \param text The text to find
+        /// \param from The newest line to search, must be a line in the history
+        /// \return The matching line, or `end()` if no line at or before `from` contains the text
+        const_iterator rfind(std::string_view text, const_iterator from) const {
+            const auto mask = char_mask(text);
+            for (auto it = from;; --it) {
+                const char *record = record_of(it.number());
+                if ((record_mask(record) & mask) == mask && line(record).find(text) != std::string_view::npos) {
+                    return it;
+                }
+                if (it == begin()) { return end(); }
             }
-
-            increment(head_);
         }
 
     private:
         friend const_iterator;
-        static constexpr difference_type lineLen_ = LineLen + 1;
-        static constexpr difference_type bufferSize_ = NumLines * lineLen_;
+
+        static constexpr size_type overhead_ = 1 + sizeof(std::uint32_t);
+        static constexpr size_type record_size(size_type length) { return length + overhead_; }
+
+        static constexpr size_type lineBudget_ = NumLines * (LineLen + 1);
+        // A single line of the maximum length may need a little more than the budget
+        using offset_type = std::conditional_t<(lineBudget_ + overhead_ <= 0xff), std::uint8_t, std::uint16_t>;
+        static_assert(lineBudget_ + overhead_ <= 0xffff, "records are stored as 16 bit offsets");
+        static constexpr size_type tableSize_ =
+                std::max(NumLines, std::min(NumLines * 8, lineBudget_ / (8 * sizeof(offset_type))));
+        static constexpr size_type bufferSize_ =
+                std::max(lineBudget_ - tableSize_ * sizeof(offset_type), record_size(LineLen));
+        static constexpr bool indexed_ = IndexSize > 0;
+        static constexpr size_type maxIndexed_ = IndexSize * 3 / 4;
+        // Compacting moves every line, so it waits until enough space is erased to pay for itself
+        static constexpr size_type compact_threshold_ = std::max<size_type>(bufferSize_ / 4, 1);
+        static constexpr size_type maxLines_ = indexed_ ? std::min(tableSize_, maxIndexed_) : tableSize_;
+        // No record starts this close to the end of the buffer, so the value marks an erased line without a record
+        static constexpr offset_type hole_ = std::numeric_limits<offset_type>::max();
+        // The char masks use the lower 31 bits
+        static constexpr std::uint32_t erased_bit_ = 1u << 31;
+
+        /// \brief A slot of the index, holding a line's offset plus one, or 0 if empty, and its hash
+        struct index_slot {
+            std::uint16_t record{0};
+            std::uint16_t hash{0};
+        };
+
         char buffer_[bufferSize_]{};
-        char *const bufferEnd_{&buffer_[bufferSize_]};
-        char *head_{buffer_};
-        char *tail_{buffer_};
-        size_type numCmds_{0};
+        // Records are stored from the oldest at tail_ up to head_, if the ring has wrapped the oldest records
+        // run from tail_ to end_, and the newest from the start of the buffer to head_
+        offset_type head_{0};
+        offset_type tail_{0};
+        offset_type end_{0};
+        // Records in the ring, including erased ones
+        offset_type numRecords_{0};
+        offset_type numLines_{0};
+        offset_type erasedBytes_{0};
+        // The offsets of the records in the order they were pushed, or holes for erased lines whose records
+        // were compacted away. The entry at the front is line firstNumber_.
+        container::ring_buffer<offset_type, tableSize_> lines_{};
+        size_type firstNumber_{1};
+        index_slot index_[indexed_ ? IndexSize : 1]{};
 
-        void increment(const char *&p) const {
-            p += lineLen_;
-            if (p >= bufferEnd_) { p -= bufferSize_; }
+        [[nodiscard]] size_type record_at(size_type pos) const {
+            return record_size(static_cast<unsigned char>(buffer_[pos]));
         }
 
-        void increment(char *&p) const {
-            p += lineLen_;
-            if (p >= bufferEnd_) { p -= bufferSize_; }
+        [[nodiscard]] size_type offset(const char *record) const { return static_cast<size_type>(record - buffer_); }
+
+        [[nodiscard]] size_type end_number() const { return firstNumber_ + lines_.size(); }
+
+        /// \return The record of a line, or nullptr if there is no line with the number
+        [[nodiscard]] const char *record_of(size_type number) const {
+            if (number < firstNumber_ || number >= end_number()) { return nullptr; }
+            auto entry = lines_[number - firstNumber_];
+            if (entry == hole_ || erased(&buffer_[entry])) { return nullptr; }
+            return &buffer_[entry];
         }
 
-        void decrement(const char *&p) const {
-            p -= lineLen_;
-            if (p < buffer_) { p += bufferSize_; }
+        [[nodiscard]] bool holds(size_type number) const { return record_of(number) != nullptr; }
+
+        [[nodiscard]] std::string_view at(size_type number) const {
+            const char *record = record_of(number);
+            return record == nullptr ? std::string_view{} : line(record);
         }
 
-        void decrement(char *&p) const {
-            p -= lineLen_;
-            if (p < buffer_) { p += bufferSize_; }
+        [[nodiscard]] std::string_view line(const char *record) const {
+            return {record + 1, static_cast<unsigned char>(*record)};
+        }
+
+        [[nodiscard]] std::uint32_t record_mask(const char *record) const {
+            std::uint32_t mask;
+            std::memcpy(&mask, record + 1 + line(record).size(), sizeof(mask));
+            return mask;
+        }
+
+        [[nodiscard]] bool erased(const char *record) const { return (record_mask(record) & erased_bit_) != 0; }
+
+        [[nodiscard]] bool wrapped() const { return head_ < tail_ || (head_ == tail_ && numRecords_ > 0); }
+
+        void erase(const char *record) {
+            unindex(record);
+            erasedBytes_ += record_size(line(record).size());
+            auto mask = record_mask(record) | erased_bit_;
+            std::memcpy(&buffer_[offset(record) + 1 + line(record).size()], &mask, sizeof(mask));
+            --numLines_;
+            drop_erased();
+        }
+
+        /// \brief Finds where a record fits without overwriting any line
+        bool find_space(size_type size, size_type &pos) {
+            if (numRecords_ == 0) { head_ = tail_ = 0; }
+            if (wrapped()) {
+                pos = head_;
+                return head_ + size <= tail_;
+            }
+            if (head_ + size <= bufferSize_) {
+                pos = head_;
+                return true;
+            }
+            if (size <= tail_) {
+                end_ = head_;
+                pos = 0;
+                return true;
+            }
+            return false;
+        }
+
+        /// \brief Removes the oldest line
+        void evict() {
+            unindex(&buffer_[tail_]);
+            --numLines_;
+            pop_record();
+            drop_erased();
+        }
+
+        /// \brief Removes the record at the tail of the ring, which is the oldest entry of the table
+        void pop_record() {
+            bool wasWrapped = wrapped();
+            tail_ += record_at(tail_);
+            if (wasWrapped && tail_ == end_) { tail_ = 0; }
+            --numRecords_;
+            lines_.pop();
+            ++firstNumber_;
+        }
+
+        /// \brief Removes the erased lines from the front of the table, so the oldest entry is a line
+        void drop_erased() {
+            while (!lines_.empty()) {
+                if (lines_.front() == hole_) {
+                    lines_.pop();
+                    ++firstNumber_;
+                } else if (erased(&buffer_[lines_.front()])) {
+                    erasedBytes_ -= record_at(tail_);
+                    pop_record();
+                } else {
+                    break;
+                }
+            }
+        }
+
+        /// \brief Moves the lines to the start of the buffer, oldest first, dropping erased lines
+        ///
+        /// The table holds the records in the order they are stored, so the records are moved in its order.
+        void compact() {
+            std::rotate(buffer_, buffer_ + tail_, buffer_ + bufferSize_);
+            size_type write = 0;
+            for (size_type i = 0; i < lines_.size(); ++i) {
+                auto &entry = lines_[i];
+                if (entry == hole_) { continue; }
+                auto pos = entry >= tail_ ? entry - tail_ : entry + bufferSize_ - tail_;
+                if (erased(&buffer_[pos])) {
+                    entry = hole_;
+                    continue;
+                }
+                // Records only move towards the start of the buffer
+                auto size = record_at(pos);
+                if (write != pos) { std::copy(&buffer_[pos], &buffer_[pos + size], &buffer_[write]); }
+                entry = static_cast<offset_type>(write);
+                write += size;
+            }
+            tail_ = 0;
+            head_ = write;
+            numRecords_ = numLines_;
+            erasedBytes_ = 0;
+
+            if constexpr (indexed_) {
+                std::fill(std::begin(index_), std::end(index_), index_slot{});
+                for (size_type i = 0; i < lines_.size(); ++i) {
+                    if (lines_[i] != hole_) { index(&buffer_[lines_[i]], hash_line(line(&buffer_[lines_[i]]))); }
+                }
+            }
+        }
+
+        /// \brief A bit for each char in the text, chars that are 31 apart share a bit
+        static constexpr std::uint32_t char_mask(std::string_view text) {
+            std::uint32_t mask = 0;
+            for (char ch : text) { mask |= 1u << (static_cast<unsigned char>(ch) % 31u); }
+            return mask;
+        }
+
+        /// \brief FNV-1a, folded to 16 bits
+        static constexpr std::uint16_t hash_line(std::string_view text) {
+            std::uint32_t hash = 2166136261u;
+            for (char ch : text) { hash = (hash ^ static_cast<unsigned char>(ch)) * 16777619u; }
+            return static_cast<std::uint16_t>(hash ^ (hash >> 16));
+        }
+
+        static constexpr size_type slot_after(size_type slot) { return (slot + 1) & (IndexSize - 1); }
+
+        /// \brief Finds the live record holding a line
+        /// \return The record, or nullptr if the line is not in the history
+        [[nodiscard]] const char *find(std::string_view text, std::uint16_t hash) const {
+            if constexpr (indexed_) {
+                for (auto slot = hash & (IndexSize - 1); index_[slot].record != 0; slot = slot_after(slot)) {
+                    const char *record = &buffer_[index_[slot].record - 1];
+                    if (index_[slot].hash == hash && line(record) == text) { return record; }
+                }
+            } else {
+                for (auto it = begin(); it != end(); ++it) {
+                    if (*it == text) { return record_of(it.number()); }
+                }
+            }
+            return nullptr;
+        }
+
+        void index(const char *record, std::uint16_t hash) {
+            if constexpr (indexed_) {
+                auto slot = hash & (IndexSize - 1);
+                while (index_[slot].record != 0) { slot = slot_after(slot); }
+                index_[slot] = {static_cast<std::uint16_t>(offset(record) + 1), hash};
+            }
+        }
+
+        /// \brief Removes a record from the index, moving later slots back so no probe sequence is broken
+        void unindex(const char *record) {
+            if constexpr (indexed_) {
+                auto slot = hash_line(line(record)) & (IndexSize - 1);
+                while (index_[slot].record != offset(record) + 1) { slot = slot_after(slot); }
+                for (auto next = slot_after(slot); index_[next].record != 0; next = slot_after(next)) {
+                    // Entries whose home slot is cyclically after the hole stay where they are
+                    auto home = index_[next].hash & (IndexSize - 1);
+                    bool stays = slot <= next ? (slot < home && home <= next) : (slot < home || home <= next);
+                    if (!stays) {
+                        index_[slot] = index_[next];
+                        slot = next;
+                    }
+                }
+                index_[slot] = {};
+            }
         }
     };
-}// namespace hh::shell
\ No newline at end of file
+}// namespace hh::shell
@@ -0,0 +1,66 @@
+/// \file command_stats.hpp
+/// \brief Run time statistics for each command, to find the commands that block the longest
+
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <hh/command_table.hpp>
+#include <span>
+
+namespace hh::shell {
+
+    /// \brief A source of timestamps for timing commands, such as SysTick or a free running hardware timer
+    ///
+    /// Timestamps are in ticks, and may wrap.
+    template<class T>
+    concept command_timer = requires {
+        { T::now() } -> std::convertible_to<std::uint32_t>;
+    };
+
+    /// \brief The default timer, commands are not timed and no time is spent recording statistics
+    struct no_command_timer {};
+
+    /// \brief Call count, worst case and log scale histogram of the time a command ran for
+    ///
+    /// Written only by the shell running the command. Each field is a volatile word that is loaded and stored
+    /// in one instruction, so reading the statistics from another task or an interrupt never blocks and never
+    /// sees half a count. As in `ring_buffer`, std::atomic is not used, it is not always lock-free on cores
+    /// without LDREX/STREX, such as Cortex-M0. The fields are not ordered with each other, a reader may see a
+    /// call before its bucket is counted.
+    struct command_stats {
+        /// \brief Bucket 0 counts runs of 0 ticks, bucket n runs of [2^(n-1), 2^n) ticks, the last bucket also
+        /// counts all longer runs
+        static constexpr std::size_t num_buckets = 12;
+
+        static_assert(sizeof(std::uint32_t) <= sizeof(void *) && alignof(std::uint32_t) == sizeof(std::uint32_t),
+                      "statistics need counts that are loaded and stored in one instruction");
+
+        volatile std::uint32_t calls{0};
+        volatile std::uint32_t max_ticks{0};
+        volatile std::uint16_t buckets[num_buckets]{};
+
+        [[nodiscard]] static constexpr std::size_t bucket(std::uint32_t ticks) {
+            return std::min<std::size_t>(std::bit_width(ticks), num_buckets - 1);
+        }
+
+        /// \brief Records one run of the command, counts saturate instead of wrapping
+        void record(std::uint32_t ticks) {
+            calls = calls + 1;
+            if (ticks > max_ticks) { max_ticks = ticks; }
+            auto &count = buckets[bucket(ticks)];
+            if (const std::uint16_t n = count; n != UINT16_MAX) { count = static_cast<std::uint16_t>(n + 1); }
+        }
+
+        void reset() {
+            calls = 0;
+            max_ticks = 0;
+            for (auto &count : buckets) { count = 0; }
+        }
+    };
+
+    /// \brief Writes a line for each command that has run, with its calls, worst case ticks and histogram
+    /// \param stats The statistics of each command, in the same order as the commands
+    void print_command_stats(cmd_ostream &out, command_set commands, std::span<const command_stats> stats);
+}// namespace hh::shell
@@ -0,0 +1,207 @@
+/// \file command_table.hpp
+/// \brief Compile time command lookup tables for the shell
+
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <hh/command_task.hpp>
+#include <hh/mini_stream.hpp>
+#include <span>
+#include <string_view>
+
+namespace hh::shell {
+
+    /// \brief The output stream commands write to
+    using cmd_ostream = oserial_stream<output_sink>;
+
+    /// \brief Statuses reported in batch mode and framed responses for requests that could not run a command
+    ///
+    /// Commands report their own return value, these are negative so they can be told apart from it.
+    /// Typed commands return `status_bad_arguments` when their arguments cannot be parsed.
+    enum batch_status : int {
+        status_unknown_command = -1,
+        status_bad_arguments = -2,
+        status_no_free_frames = -3,
+        /// \brief A framed request arrived while the previous one was still running
+        status_busy = -4,
+        /// \brief A line arrived while a command ran and did not fit in the line queue, it was dropped along
+        /// with the lines after it until this status
+        status_queue_full = -5,
+    };
+
+    /// \brief A single entry in a command table
+    ///
+    /// Commands either run to completion in `execute`, or are coroutines started by `execute_async`.
+    struct command {
+        /// \brief The arguments of a command, the first argument is the command name
+        using argv_type = std::span<const std::string_view>;
+        using cmd_function = int(argv_type argv, cmd_ostream &out);
+        using task_function = command_task(argv_type argv, cmd_ostream &out);
+        cmd_function *execute{nullptr};
+        const char *cmd_name;
+        const char *help_message;
+        /// \brief Optional null terminated list of argument keywords, used for tab completion
+        const char *const *keywords{nullptr};
+        task_function *execute_async{nullptr};
+    };
+
+    namespace detail {
+        /// \brief FNV-1a hash of a command name, computed once per lookup
+        constexpr std::uint32_t hash_name(std::string_view name) {
+            std::uint32_t h = 2166136261u;
+            for (char ch : name) {
+                h ^= static_cast<std::uint8_t>(ch);
+                h *= 16777619u;
+            }
+            return h;
+        }
+
+        /// \brief Mixes a name hash with a seed, so that the low bits depend on every bit of the input
+        constexpr std::uint32_t mix_hash(std::uint32_t h, std::uint32_t seed) {
+            h ^= seed * 0x9e3779b9u;
+            h ^= h >> 16;
+            h *= 0x85ebca6bu;
+            h ^= h >> 13;
+            h *= 0xc2b2ae35u;
+            h ^= h >> 16;
+            return h;
+        }
+
+        constexpr std::uint16_t empty_slot = 0xffff;
+
+        // Not constexpr, calling these while building a table at compile time is a compile error
+        void duplicate_command_name();
+        void command_table_build_failed();
+    }// namespace detail
+
+    /// \brief A non owning view of a command table, used by the shell so it does not depend on the table size
+    class command_set {
+    public:
+        constexpr command_set() = default;
+        constexpr command_set(const command *commands, std::size_t size, const std::uint16_t *displacements,
+                              const std::uint16_t *slots, std::uint32_t mask)
+            : commands_{commands}, size_{size}, displacements_{displacements}, slots_{slots}, mask_{mask} {}
+
+        [[nodiscard]] constexpr const command *begin() const { return commands_; }
+        [[nodiscard]] constexpr const command *end() const { return commands_ + size_; }
+        [[nodiscard]] constexpr std::size_t size() const { return size_; }
+        [[nodiscard]] constexpr bool empty() const { return size_ == 0; }
+
+        /// \brief Finds a command by name
+        ///
+        /// Hashes the name once and compares it against at most one command name.
+        /// \param name The name of the command
+        /// \return A pointer to the command, or nullptr if there is no command with the given name
+        [[nodiscard]] constexpr const command *find(std::string_view name) const {
+            if (empty()) { return nullptr; }
+            auto h = detail::hash_name(name);
+            auto displacement = displacements_[detail::mix_hash(h, 0) & mask_];
+            auto idx = slots_[detail::mix_hash(h, displacement) & mask_];
+            if (idx == detail::empty_slot || name != commands_[idx].cmd_name) { return nullptr; }
+            return &commands_[idx];
+        }
+
+    private:
+        const command *commands_{nullptr};
+        std::size_t size_{0};
+        const std::uint16_t *displacements_{nullptr};
+        const std::uint16_t *slots_{nullptr};
+        std::uint32_t mask_{0};
+    };
+
+    /// \brief A fixed size table of commands with a perfect hash built from the command names
+    ///
+    /// Intended to be declared `static constexpr`, so both the commands and the hash are built at compile
+    /// time and placed in flash. Uses hash and displace: every name is first hashed into a bucket, and each
+    /// bucket stores the seed that maps all of its names to unused slots.
+    /// \tparam N The number of commands
+    template<std::size_t N>
+    class command_table {
+    public:
+        static_assert(N > 0, "command tables must contain at least one command");
+        static_assert(N < detail::empty_slot, "too many commands");
+
+        constexpr command_table(const command (&commands)[N]) {
+            for (std::size_t i = 0; i < N; ++i) { commands_[i] = commands[i]; }
+            build();
+        }
+
+        [[nodiscard]] constexpr const command *begin() const { return commands_.data(); }
+        [[nodiscard]] constexpr const command *end() const { return commands_.data() + N; }
+        [[nodiscard]] constexpr std::size_t size() const { return N; }
+
+        [[nodiscard]] constexpr const command *find(std::string_view name) const {
+            return command_set{*this}.find(name);
+        }
+
+        constexpr operator command_set() const {
+            return {commands_.data(), N, displacements_.data(), slots_.data(), mask_};
+        }
+
+    private:
+        static constexpr std::size_t num_slots_ = std::bit_ceil(N);
+        static constexpr std::uint32_t mask_ = num_slots_ - 1;
+        static constexpr std::uint32_t max_displacement_ = 0xfffe;
+
+        std::array<command, N> commands_{};
+        std::array<std::uint16_t, num_slots_> displacements_{};
+        std::array<std::uint16_t, num_slots_> slots_{};
+
+        constexpr void build() {
+            std::array<std::uint32_t, N> hashes{};
+            std::array<std::uint16_t, num_slots_> bucketSizes{};
+
+            for (std::size_t i = 0; i < N; ++i) {
+                std::string_view name{commands_[i].cmd_name};
+                for (std::size_t j = 0; j < i; ++j) {
+                    if (name == commands_[j].cmd_name) { detail::duplicate_command_name(); }
+                }
+                hashes[i] = detail::hash_name(name);
+                ++bucketSizes[bucket_of(hashes[i])];
+            }
+
+            slots_.fill(detail::empty_slot);
+
+            // Place the largest buckets first, while most slots are still free
+            for (std::size_t size = N; size > 0; --size) {
+                for (std::size_t b = 0; b < num_slots_; ++b) {
+                    if (bucketSizes[b] == size) { place_bucket(b, hashes); }
+                }
+            }
+        }
+
+        constexpr void place_bucket(std::size_t bucket, const std::array<std::uint32_t, N> &hashes) {
+            for (std::uint32_t d = 1; d <= max_displacement_; ++d) {
+                if (try_place(bucket, d, hashes)) {
+                    displacements_[bucket] = static_cast<std::uint16_t>(d);
+                    return;
+                }
+            }
+            detail::command_table_build_failed();
+        }
+
+        constexpr bool try_place(std::size_t bucket, std::uint32_t displacement,
+                                 const std::array<std::uint32_t, N> &hashes) {
+            std::array<std::uint16_t, N> placed{};
+            std::size_t numPlaced = 0;
+
+            for (std::size_t i = 0; i < N; ++i) {
+                if (bucket_of(hashes[i]) != bucket) { continue; }
+                auto slot = detail::mix_hash(hashes[i], displacement) & mask_;
+                if (slots_[slot] != detail::empty_slot) {
+                    // Undo the slots claimed by this bucket so far
+                    for (std::size_t j = 0; j < numPlaced; ++j) { slots_[placed[j]] = detail::empty_slot; }
+                    return false;
+                }
+                slots_[slot] = static_cast<std::uint16_t>(i);
+                placed[numPlaced++] = static_cast<std::uint16_t>(slot);
+            }
+            return true;
+        }
+
+        static constexpr std::size_t bucket_of(std::uint32_t hash) {
+            return detail::mix_hash(hash, 0) & mask_;
+        }
+    };
+}// namespace hh::shell
@@ -0,0 +1,195 @@
+/// \file command_task.hpp
+/// \brief Coroutine commands, which can wait for output space, time or input without blocking the shell
+
+#pragma once
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <hh/lock.hpp>
+#include <span>
+#include <utility>
+
+namespace hh::shell {
+
+    /// \brief The largest coroutine frame a command may use, unless the shell's config sets another size
+    inline constexpr std::size_t default_command_frame_size = 512;
+    /// \brief The number of coroutine commands that can be running at once, unless the shell's config sets another
+    inline constexpr std::size_t default_max_command_frames = 2;
+
+    /// \brief What a suspended command is waiting for
+    enum class wait_reason : std::uint8_t {
+        none,
+        tx_ready,
+        ticks,
+        input,
+    };
+
+    /// \brief The return type of coroutine commands
+    ///
+    /// Command coroutines start running as soon as they are called, and are resumed by the shell when the
+    /// thing they are waiting for happens. Frames are allocated from the attached `frame_pool`, never from the
+    /// heap. If no frame is free the returned task is not `valid()` and the command does not run.
+    class command_task {
+    public:
+        struct promise_type {
+            int result{0};
+            wait_reason waiting{wait_reason::none};
+            std::uint32_t ticks{0};
+            int input{0};
+
+            command_task get_return_object() {
+                return command_task{std::coroutine_handle<promise_type>::from_promise(*this)};
+            }
+            static command_task get_return_object_on_allocation_failure() { return command_task{}; }
+
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_value(int value) { result = value; }
+            void unhandled_exception() { std::terminate(); }
+
+            static void *operator new(std::size_t size) noexcept;
+            static void operator delete(void *frame) noexcept;
+        };
+
+        using handle_type = std::coroutine_handle<promise_type>;
+
+        command_task() = default;
+        command_task(const command_task &) = delete;
+        command_task &operator=(const command_task &) = delete;
+        command_task(command_task &&other) noexcept
+            : handle_{std::exchange(other.handle_, nullptr)} {}
+        command_task &operator=(command_task &&other) noexcept {
+            if (this != &other) {
+                reset();
+                handle_ = std::exchange(other.handle_, nullptr);
+            }
+            return *this;
+        }
+        ~command_task() { reset(); }
+
+        /// \brief Checks if the task holds a coroutine
+        [[nodiscard]] bool valid() const { return static_cast<bool>(handle_); }
+        /// \brief Checks if the coroutine has returned
+        [[nodiscard]] bool done() const { return handle_.done(); }
+        /// \brief Checks if the coroutine is suspended, and has not returned
+        [[nodiscard]] bool running() const { return valid() && !done(); }
+        /// \brief The value returned by the coroutine
+        [[nodiscard]] int result() const { return handle_.promise().result; }
+        [[nodiscard]] promise_type &promise() const { return handle_.promise(); }
+
+        /// \brief Resumes the coroutine, clearing what it was waiting for
+        void resume() {
+            handle_.promise().waiting = wait_reason::none;
+            handle_.resume();
+        }
+
+        /// \brief Destroys the coroutine, cancelling it if it has not returned
+        void reset() {
+            if (handle_) { handle_.destroy(); }
+            handle_ = nullptr;
+        }
+
+    private:
+        explicit command_task(handle_type handle)
+            : handle_{handle} {}
+
+        handle_type handle_{nullptr};
+    };
+
+    /// \brief A fixed number of coroutine frames of a fixed size
+    class frame_pool {
+    public:
+        frame_pool(const frame_pool &) = delete;
+        frame_pool &operator=(const frame_pool &) = delete;
+
+        [[nodiscard]] std::size_t frame_size() const { return frameSize_; }
+        [[nodiscard]] std::size_t max_frames() const { return used_.size(); }
+        /// \brief Checks if any frame is taken
+        [[nodiscard]] bool in_use() const;
+
+        /// \return A free frame, or nullptr if none is free or the size does not fit in a frame
+        void *allocate(std::size_t size) noexcept;
+        void deallocate(void *frame) noexcept;
+
+    protected:
+        frame_pool(std::byte *frames, std::size_t frameSize, std::span<bool> used)
+            : frames_{frames}, frameSize_{frameSize}, used_{used} {}
+        ~frame_pool() = default;
+
+    private:
+        std::byte *frames_;
+        std::size_t frameSize_;
+        std::span<bool> used_;
+    };
+
+    /// \brief A frame pool holding its frames
+    /// \tparam FrameSize The largest coroutine frame a command may use
+    /// \tparam NumFrames The number of coroutine commands that can be running at once
+    template<std::size_t FrameSize, std::size_t NumFrames>
+    class static_frame_pool : public frame_pool {
+    public:
+        static_assert(FrameSize > 0 && NumFrames > 0, "commands need at least one frame");
+
+        static_frame_pool()
+            : frame_pool{&frames_[0][0], FrameSize, used_} {}
+
+    private:
+        alignas(std::max_align_t) std::byte frames_[NumFrames][FrameSize]{};
+        bool used_[NumFrames]{};
+    };
+
+    /// \brief The pool of `default_max_command_frames` frames of `default_command_frame_size` bytes, attached
+    /// until a shell attaches another
+    frame_pool &default_frame_pool();
+
+    /// \brief Makes a pool the one coroutine frames are allocated from, holding a lock while taking and
+    /// returning frames
+    ///
+    /// Command coroutines are called without knowing which shell runs them, so one pool is attached at a time.
+    /// Every shell attaches the pool and the lock of its config when it is constructed, and detaches them when
+    /// it is destroyed. Shells that exist at the same time must attach the same pool and lock, which is
+    /// asserted, so shells on different threads cannot each guard the pool with a lock of their own. Another
+    /// pool can only be attached once every shell has detached and no frame of the old pool is in use.
+    void attach_frame_pool(frame_pool &pool, lock_ref lock);
+    void detach_frame_pool();
+
+    /// \brief Suspends a command until the shell's output has been written and `notify_tx_ready()` is called
+    ///
+    /// A command piped into another is resumed once that command has read everything it wrote, so it can
+    /// write more than fits in the pipe without any of it being discarded.
+    struct tx_ready {
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(command_task::handle_type handle) const noexcept {
+            handle.promise().waiting = wait_reason::tx_ready;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    /// \brief Suspends a command until `notify_tick()` has been called a number of times
+    struct sleep_for {
+        std::uint32_t ticks;
+
+        bool await_ready() const noexcept { return ticks == 0; }
+        void await_suspend(command_task::handle_type handle) const noexcept {
+            handle.promise().waiting = wait_reason::ticks;
+            handle.promise().ticks = ticks;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    /// \brief Returned by `next_char` once a piped command has read all of its input
+    inline constexpr int end_of_input = -1;
+
+    /// \brief Suspends a command until a char is received, and returns the char, or `end_of_input`
+    struct next_char {
+        command_task::handle_type handle{nullptr};
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(command_task::handle_type h) noexcept {
+            handle = h;
+            handle.promise().waiting = wait_reason::input;
+        }
+        int await_resume() const noexcept { return handle.promise().input; }
+    };
+}// namespace hh::shell
@@ -0,0 +1,187 @@
+/// \file completion_trie.hpp
+/// \brief Compile time prefix tries for tab completion of commands and their keywords
+
+#pragma once
+#include <array>
+#include <cstdint>
+#include <hh/command_table.hpp>
+#include <string_view>
+
+namespace hh::shell {
+
+    /// \brief A node in a completion trie, children are stored as a linked list of siblings
+    struct trie_node {
+        char ch{};
+        bool terminal{false};
+        std::uint16_t first_child{0};
+        std::uint16_t next_sibling{0};
+    };
+
+    /// \brief The result of completing a prefix
+    struct completion {
+        /// \brief The number of chars written to the suffix buffer
+        std::size_t length{0};
+        /// \brief True if the prefix matched a word
+        bool found{false};
+        /// \brief True if the completed word is the only word with the prefix
+        bool unique{false};
+    };
+
+    namespace detail {
+        template<std::size_t Capacity, std::size_t NumCommands>
+        struct trie_builder {
+            std::array<trie_node, Capacity> nodes{};
+            std::size_t size{0};
+            std::array<std::uint16_t, NumCommands> keyword_roots{};
+
+            constexpr std::uint16_t add_node(char ch) {
+                nodes[size].ch = ch;
+                return static_cast<std::uint16_t>(size++);
+            }
+
+            constexpr void insert(std::uint16_t root, std::string_view word) {
+                auto node = root;
+                for (char ch : word) {
+                    auto child = nodes[node].first_child;
+                    auto last = std::uint16_t{0};
+                    while (child != 0 && nodes[child].ch != ch) {
+                        last = child;
+                        child = nodes[child].next_sibling;
+                    }
+                    if (child == 0) {
+                        child = add_node(ch);
+                        if (last == 0) {
+                            nodes[node].first_child = child;
+                        } else {
+                            nodes[last].next_sibling = child;
+                        }
+                    }
+                    node = child;
+                }
+                nodes[node].terminal = true;
+            }
+        };
+
+        template<class Table>
+        constexpr std::size_t trie_capacity(const Table &commands) {
+            // One node per char is always enough, shared prefixes only make the trie smaller
+            std::size_t capacity = 1;
+            for (const auto &cmd : commands) {
+                capacity += std::string_view{cmd.cmd_name}.size();
+                if (cmd.keywords == nullptr) { continue; }
+                ++capacity;
+                for (auto kw = cmd.keywords; *kw != nullptr; ++kw) { capacity += std::string_view{*kw}.size(); }
+            }
+            return capacity;
+        }
+
+        template<std::size_t Capacity, std::size_t NumCommands, class Table>
+        constexpr auto build_trie(const Table &commands) {
+            trie_builder<Capacity, NumCommands> builder{};
+            auto root = builder.add_node(0);
+            for (const auto &cmd : commands) { builder.insert(root, cmd.cmd_name); }
+
+            for (std::size_t i = 0; i < commands.size(); ++i) {
+                const auto &cmd = commands.begin()[i];
+                if (cmd.keywords == nullptr) { continue; }
+                auto kwRoot = builder.add_node(0);
+                builder.keyword_roots[i] = kwRoot;
+                for (auto kw = cmd.keywords; *kw != nullptr; ++kw) { builder.insert(kwRoot, *kw); }
+            }
+            return builder;
+        }
+    }// namespace detail
+
+    /// \brief A non owning view of a completion trie, used by the shell so it does not depend on the trie size
+    class completion_set {
+    public:
+        constexpr completion_set() = default;
+        constexpr completion_set(const trie_node *nodes, const std::uint16_t *keywordRoots, const command *commands)
+            : nodes_{nodes}, keywordRoots_{keywordRoots}, commands_{commands} {}
+
+        [[nodiscard]] constexpr bool empty() const { return nodes_ == nullptr; }
+
+        /// \brief Completes a command name
+        /// \param prefix The start of the command name
+        /// \param suffix Receives the chars missing from the prefix
+        /// \param max_len The size of the suffix buffer
+        constexpr completion complete_command(std::string_view prefix, char *suffix, std::size_t max_len) const {
+            if (empty()) { return {}; }
+            return complete(0, prefix, suffix, max_len);
+        }
+
+        /// \brief Completes an argument keyword
+        /// \param cmd The command the keyword is for, must be from the table the trie was built from
+        /// \param prefix The start of the keyword
+        /// \param suffix Receives the chars missing from the prefix
+        /// \param max_len The size of the suffix buffer
+        constexpr completion complete_keyword(const command &cmd, std::string_view prefix, char *suffix,
+                                              std::size_t max_len) const {
+            if (empty()) { return {}; }
+            auto root = keywordRoots_[&cmd - commands_];
+            if (root == 0) { return {}; }
+            return complete(root, prefix, suffix, max_len);
+        }
+
+    private:
+        const trie_node *nodes_{nullptr};
+        const std::uint16_t *keywordRoots_{nullptr};
+        const command *commands_{nullptr};
+
+        constexpr completion complete(std::uint16_t node, std::string_view prefix, char *suffix,
+                                      std::size_t max_len) const {
+            for (char ch : prefix) {
+                node = find_child(node, ch);
+                if (node == 0) { return {}; }
+            }
+
+            // Follow the trie for as long as there is only one way to continue
+            completion result{0, true, false};
+            while (!nodes_[node].terminal && result.length < max_len) {
+                auto child = nodes_[node].first_child;
+                if (child == 0 || nodes_[child].next_sibling != 0) { return result; }
+                suffix[result.length++] = nodes_[child].ch;
+                node = child;
+            }
+            result.unique = nodes_[node].terminal && nodes_[node].first_child == 0;
+            return result;
+        }
+
+        [[nodiscard]] constexpr std::uint16_t find_child(std::uint16_t node, char ch) const {
+            auto child = nodes_[node].first_child;
+            while (child != 0 && nodes_[child].ch != ch) { child = nodes_[child].next_sibling; }
+            return child;
+        }
+    };
+
+    /// \brief A prefix trie of the command names and argument keywords in a command table
+    ///
+    /// The trie is built at compile time and stored in flash, sized to the number of distinct prefixes.
+    /// \tparam Commands A command table with static storage duration
+    template<const auto &Commands>
+    class completion_trie {
+    public:
+        [[nodiscard]] static constexpr std::size_t size() { return num_nodes_; }
+
+        constexpr operator completion_set() const {
+            return {nodes_.data(), keywordRoots_.data(), Commands.begin()};
+        }
+
+    private:
+        static constexpr std::size_t num_commands_ = Commands.size();
+        static constexpr std::size_t capacity_ = detail::trie_capacity(Commands);
+
+        static_assert(capacity_ < 0xffff, "too many chars in command names and keywords");
+
+        // Only used while compiling, the nodes are copied into an array of the exact size
+        static constexpr auto builder_ = detail::build_trie<capacity_, num_commands_>(Commands);
+        static constexpr std::size_t num_nodes_ = builder_.size;
+
+        static constexpr std::array<std::uint16_t, num_commands_> keywordRoots_ = builder_.keyword_roots;
+        static constexpr std::array<trie_node, num_nodes_> nodes_ = [] {
+            std::array<trie_node, num_nodes_> nodes{};
+            for (std::size_t i = 0; i < num_nodes_; ++i) { nodes[i] = builder_.nodes[i]; }
+            return nodes;
+        }();
+    };
+}// namespace hh::shell
@@ -12,11 +12,28 @@ namespace hh::shell {
         so.flush();
     };
 
+    /// \brief A serial output device that can also write without blocking
+    ///
+    /// `try_write` copies as many of the `count` chars as the device can accept right away, and returns the
+    /// number copied.
+    template<typename T>
+    concept serial_nonblocking_out_device = serial_out_device<T> && requires(T so, const char *s, std::size_t count) {
+        { so.try_write(s, count) } -> std::convertible_to<std::size_t>;
+    };
+
     template<typename T>
     concept serial_in_device = std::movable<T> && requires(T si, char *s, std::size_t count, char ch) {
         { si.get() } -> std::convertible_to<int>;
     };
 
+    /// \brief A serial input device that can also read a block of chars in a single call
+    ///
+    /// `read` copies up to `count` available chars into `s` without blocking, and returns the number copied.
+    template<typename T>
+    concept serial_bulk_in_device = serial_in_device<T> && requires(T si, char *s, std::size_t count) {
+        { si.read(s, count) } -> std::convertible_to<std::size_t>;
+    };
+
     template<typename T>
     concept serial_io_device = requires {
         serial_in_device<T> &&serial_out_device<T>;
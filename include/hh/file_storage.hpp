@@ -0,0 +1,41 @@
+/// \file file_storage.hpp
+/// \brief Block storage kept in a file, for the history log of host builds and tests
+
+#pragma once
+#include <cstddef>
+#include <cstdio>
+#include <span>
+
+namespace hh::shell {
+
+    /// \brief Pages of storage in a file, behaving like erased flash where the file has not been written
+    ///
+    /// Models `block_storage`. Each program and erase is written through to the file, so lines reach it as
+    /// soon as the history log programs them.
+    class file_storage {
+    public:
+        /// \brief Opens the file, creating it if it does not exist
+        file_storage(const char *path, std::size_t pageSize, std::size_t pageCount);
+        ~file_storage();
+
+        file_storage(const file_storage &) = delete;
+        file_storage &operator=(const file_storage &) = delete;
+
+        /// \return false if the file could not be opened or created, reads then return erased pages and
+        /// writes are dropped
+        [[nodiscard]] bool is_open() const { return file_ != nullptr; }
+
+        [[nodiscard]] std::size_t page_size() const { return pageSize_; }
+        [[nodiscard]] std::size_t page_count() const { return pageCount_; }
+
+        /// \brief Reads from a page, the parts past the end of the file read as erased
+        void read(std::size_t page, std::size_t offset, std::span<char> out);
+        void program(std::size_t page, std::size_t offset, std::span<const char> in);
+        void erase(std::size_t page);
+
+    private:
+        std::FILE *file_{nullptr};
+        std::size_t pageSize_;
+        std::size_t pageCount_;
+    };
+}// namespace hh::shell
@@ -0,0 +1,118 @@
+/// \file framing.hpp
+/// \brief COBS framed packets with a CRC, for the shell's binary protocol
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace hh::shell {
+
+    /// \brief The byte that starts and ends every frame, COBS encoding removes it from the frame's contents
+    inline constexpr char frame_delimiter = '\0';
+
+    /// \brief The largest size a packet can grow to when COBS encoded
+    [[nodiscard]] constexpr std::size_t cobs_max_encoded_size(std::size_t size) { return size + size / 254 + 1; }
+
+    /// \brief COBS encodes data, writing it to an output device in blocks without a temporary buffer
+    ///
+    /// The frame delimiters are not written.
+    /// \tparam Out A type with `write(const char *, std::size_t)`
+    template<class Out>
+    void cobs_encode(Out &out, std::span<const char> data) {
+        const char *first = data.data();
+        const char *const end = first + data.size();
+        while (true) {
+            const char *last = std::find(first, first + std::min<std::ptrdiff_t>(254, end - first), '\0');
+            auto length = static_cast<std::size_t>(last - first);
+            char code = static_cast<char>(length + 1);
+            out.write(&code, 1);
+            out.write(first, length);
+            if (last == end) { break; }
+            // Full blocks are not followed by a zero, any other block replaces one
+            first = length == 254 ? last : last + 1;
+        }
+    }
+
+    /// \brief Decodes a COBS encoded frame in place, the decoded packet is never longer than the frame
+    /// \param frame The frame, without its delimiters
+    /// \param size Receives the size of the decoded packet
+    /// \return false if the frame is malformed
+    bool cobs_decode(std::span<char> frame, std::size_t &size);
+
+    /// \brief CRC-16/CCITT-FALSE, computed bit by bit to avoid a lookup table
+    /// \param data The bytes to add to the CRC
+    /// \param crc The CRC of the preceding bytes
+    std::uint16_t crc16(std::span<const char> data, std::uint16_t crc = 0xffff);
+
+    /// \brief Checks the CRC stored little endian in the last two bytes of a packet, covering the rest of it
+    /// \return false if the packet is too short to hold a sequence ID and CRC, or the CRC does not match
+    bool check_packet(std::span<const char> packet);
+
+    struct frame_args_result {
+        enum class status {
+            ok,
+            too_many_args,
+            truncated,
+        };
+
+        std::size_t argc{0};
+        status result{status::ok};
+
+        [[nodiscard]] bool good() const { return result == status::ok; }
+    };
+
+    /// \brief Splits the arguments of a request, each a length byte followed by that many bytes
+    /// \param data The arguments, after the sequence ID and before the CRC
+    /// \param args Receives views into data
+    frame_args_result decode_frame_args(std::span<const char> data, std::span<std::string_view> args);
+
+    /// \brief The size of a response packet's sequence ID and status
+    inline constexpr std::size_t frame_response_header_size = 5;
+
+    /// \brief Builds a response packet, a sequence ID, a 32 bit little endian status and the command's output
+    ///
+    /// Output is written to the packet as it would be to a device, output that does not fit is cut short.
+    /// \tparam N The largest packet, excluding the CRC
+    template<std::size_t N>
+    class frame_response {
+    public:
+        static constexpr std::size_t header_size = frame_response_header_size;
+        static_assert(N >= header_size, "responses need space for a sequence ID and status");
+
+        /// \brief Starts a new response, discarding the previous one
+        void start(std::uint8_t seq) {
+            data_[0] = static_cast<char>(seq);
+            size_ = header_size;
+        }
+
+        /// \return The number of chars that fit in the packet
+        std::size_t write(const char *s, std::size_t count) {
+            auto n = std::min(count, N - size_);
+            std::copy_n(s, n, data_ + size_);
+            size_ += n;
+            return n;
+        }
+        void flush() {}
+
+        /// \brief Stores the status and appends the CRC
+        /// \return The finished packet
+        std::span<const char> finish(int status) {
+            auto value = static_cast<std::uint32_t>(status);
+            for (std::size_t i = 0; i < 4; ++i) { data_[1 + i] = static_cast<char>(value >> (8 * i)); }
+            auto crc = crc16({data_, size_});
+            data_[size_] = static_cast<char>(crc & 0xff);
+            data_[size_ + 1] = static_cast<char>(crc >> 8);
+            return {data_, size_ + 2};
+        }
+
+        /// \brief The number of output chars in the packet
+        [[nodiscard]] std::size_t output_size() const { return size_ - header_size; }
+
+    private:
+        char data_[N + 2]{};
+        std::size_t size_{header_size};
+    };
+}// namespace hh::shell
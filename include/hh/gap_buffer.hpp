@@ -0,0 +1,172 @@
+/// \file gap_buffer.hpp
+/// \brief Fixed capacity text buffer with constant time edits at the cursor
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+namespace hh::container {
+
+    /// \brief A fixed capacity gap buffer, used as a line editing buffer
+    ///
+    /// The unused capacity is kept as a gap in the middle of the buffer, so inserting or erasing at the gap
+    /// does not move any other chars. The gap only follows the cursor when an edit is made, which costs time
+    /// proportional to the distance the cursor moved since the last edit. The text is only made contiguous
+    /// when it is requested with `data()`, `c_str()` or `view()`. Moving the gap does not change the text, so
+    /// these can be called on a const buffer.
+    /// \tparam N The maximum number of chars
+    template<std::size_t N>
+    class gap_buffer {
+    public:
+        using value_type = char;
+        using size_type = std::size_t;
+        using difference_type = std::ptrdiff_t;
+
+        constexpr gap_buffer() = default;
+        constexpr explicit gap_buffer(std::string_view s) { assign(s); }
+
+        [[nodiscard]] constexpr size_type size() const { return N - gap_size(); }
+        [[nodiscard]] constexpr size_type length() const { return size(); }
+        [[nodiscard]] constexpr bool empty() const { return size() == 0; }
+        [[nodiscard]] constexpr bool full() const { return gapStart_ == gapEnd_; }
+        [[nodiscard]] static constexpr size_type max_size() { return N; }
+
+        /// \brief The position of the cursor, chars are inserted before the cursor
+        [[nodiscard]] constexpr size_type cursor() const { return cursor_; }
+
+        [[nodiscard]] constexpr value_type operator[](size_type pos) const {
+            return pos < gapStart_ ? buffer_[pos] : buffer_[pos + gap_size()];
+        }
+
+        /// \brief Moves the cursor to a position, limited to the ends of the buffer
+        constexpr void set_cursor(size_type pos) { cursor_ = std::min(pos, size()); }
+
+        /// \brief Moves the cursor by a number of chars, limited to the ends of the buffer
+        constexpr void move_cursor(difference_type n) {
+            auto pos = static_cast<difference_type>(cursor_) + n;
+            cursor_ = static_cast<size_type>(std::clamp<difference_type>(pos, 0, size()));
+        }
+
+        /// \brief Inserts a char before the cursor and advances the cursor
+        /// \return false if the buffer is full
+        constexpr bool insert(value_type ch) {
+            if (full()) { return false; }
+            move_gap(cursor_);
+            buffer_[gapStart_++] = ch;
+            ++cursor_;
+            return true;
+        }
+
+        /// \brief Inserts chars before the cursor and advances the cursor past them
+        /// \return The number of chars inserted, less than count if the buffer filled
+        constexpr size_type insert(const value_type *s, size_type count) {
+            count = std::min(count, gap_size());
+            move_gap(cursor_);
+            std::copy_n(s, count, &buffer_[gapStart_]);
+            gapStart_ += count;
+            cursor_ += count;
+            return count;
+        }
+
+        /// \brief Erases the char before the cursor, like a backspace
+        /// \return false if the cursor is at the start of the buffer
+        constexpr bool erase_before() {
+            if (cursor_ == 0) { return false; }
+            move_gap(cursor_);
+            --gapStart_;
+            --cursor_;
+            return true;
+        }
+
+        /// \brief Erases up to count chars before the cursor
+        /// \return The number of chars erased, less than count if the cursor was closer to the start
+        constexpr size_type erase_before(size_type count) {
+            count = std::min(count, cursor_);
+            move_gap(cursor_);
+            gapStart_ -= count;
+            cursor_ -= count;
+            return count;
+        }
+
+        /// \brief The free space at the cursor
+        ///
+        /// Chars written here are inserted before the cursor by `commit()`, so text can be produced in place
+        /// instead of in a copy. The chars before the cursor stay where they are.
+        [[nodiscard]] constexpr std::span<value_type> gap() {
+            move_gap(cursor_);
+            return {&buffer_[gapStart_], gap_size()};
+        }
+
+        /// \brief Inserts chars written to the gap before the cursor, there must be space for count chars
+        constexpr void commit(size_type count) {
+            gapStart_ += count;
+            cursor_ += count;
+        }
+
+        /// \brief Erases the char after the cursor, like a delete
+        /// \return false if the cursor is at the end of the buffer
+        constexpr bool erase_after() {
+            if (cursor_ == size()) { return false; }
+            move_gap(cursor_);
+            ++gapEnd_;
+            return true;
+        }
+
+        constexpr void clear() {
+            gapStart_ = 0;
+            gapEnd_ = N;
+            cursor_ = 0;
+        }
+
+        /// \brief Replaces the contents of the buffer, and moves the cursor to the end
+        constexpr void assign(std::string_view s) {
+            clear();
+            insert(s.data(), s.size());
+        }
+
+        /// \brief Makes the contents contiguous and null terminated
+        /// \return A pointer to the first char
+        constexpr value_type *data() {
+            make_contiguous();
+            return buffer_;
+        }
+        constexpr const value_type *data() const {
+            make_contiguous();
+            return buffer_;
+        }
+
+        constexpr const value_type *c_str() const { return data(); }
+        constexpr std::string_view view() const { return {data(), size()}; }
+
+    private:
+        // One extra char so the contents can always be null terminated. The gap's position is not part of the
+        // buffer's value, so it is mutable.
+        mutable value_type buffer_[N + 1]{};
+        mutable size_type gapStart_{0};
+        mutable size_type gapEnd_{N};
+        size_type cursor_{0};
+
+        [[nodiscard]] constexpr size_type gap_size() const { return gapEnd_ - gapStart_; }
+
+        constexpr void make_contiguous() const {
+            move_gap(size());
+            buffer_[gapStart_] = 0;
+        }
+
+        constexpr void move_gap(size_type pos) const {
+            if (pos < gapStart_) {
+                auto n = gapStart_ - pos;
+                std::copy_backward(&buffer_[pos], &buffer_[gapStart_], &buffer_[gapEnd_]);
+                gapStart_ -= n;
+                gapEnd_ -= n;
+            } else if (pos > gapStart_) {
+                auto n = pos - gapStart_;
+                std::copy_n(&buffer_[gapEnd_], n, &buffer_[gapStart_]);
+                gapStart_ += n;
+                gapEnd_ += n;
+            }
+        }
+    };
+}// namespace hh::container
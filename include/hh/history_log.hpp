@@ -0,0 +1,198 @@
+/// \file history_log.hpp
+/// \brief An append only log of history lines in flash pages or a file, so the history survives a reset
+
+#pragma once
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace hh::shell {
+
+    /// \brief Storage erased a page at a time and programmed a few bytes at a time, such as flash
+    ///
+    /// `erase` sets every byte of a page to 0xff, and `program` only writes to erased bytes, in order of their
+    /// offset. Pages are numbered from 0, and offsets are from the start of a page.
+    template<class T>
+    concept block_storage = requires(T &storage, const T &cstorage, std::size_t page, std::size_t offset,
+                                     std::span<char> out, std::span<const char> in) {
+        { cstorage.page_size() } -> std::convertible_to<std::size_t>;
+        { cstorage.page_count() } -> std::convertible_to<std::size_t>;
+        storage.read(page, offset, out);
+        storage.program(page, offset, in);
+        storage.erase(page);
+    };
+
+    /// \brief The default storage, the history is lost on a reset and no space is spent on a log
+    struct no_history_storage {};
+
+    /// \brief Appends history lines to pages of storage, and replays them to rebuild the history after a reset
+    ///
+    /// Each page starts with a magic number and a sequence number, followed by records of a line's length,
+    /// its chars and the inverted length. The inverted length is programmed last, so a record cut short by a
+    /// reset is found and ignored. Pages are written in turn, and the oldest page is erased when the newest is
+    /// full, so each page is erased equally often and at most once per cycle through the storage.
+    ///
+    /// Lines are collected in a batch and programmed together, once the batch is full or flushed, so typing
+    /// a line rarely touches the storage. Nothing is read until the first line is appended or replayed.
+    /// \tparam Storage The pages lines are written to, each must hold the header and a line of `MaxLine` chars
+    /// \tparam MaxLine The maximum length of a line, at most 254, longer lines are cut short
+    /// \tparam BatchSize The number of chars of records collected before they are programmed
+    template<block_storage Storage, std::size_t MaxLine, std::size_t BatchSize = 32>
+    class history_log {
+    public:
+        static_assert(MaxLine > 0 && MaxLine < 0xff, "lengths are stored in a byte, and 0xff is erased storage");
+
+        static constexpr std::size_t header_size = 6;
+        static constexpr std::size_t overhead = 2;
+
+        explicit history_log(Storage &storage)
+            : storage_{storage} {}
+
+        history_log(const history_log &) = delete;
+        history_log &operator=(const history_log &) = delete;
+
+        /// \brief Appends a line, empty lines are not stored
+        void append(std::string_view line) {
+            line = line.substr(0, MaxLine);
+            if (line.empty()) { return; }
+            open();
+
+            const auto size = line.size() + overhead;
+            if (pagePos_ + batchSize_ + size > storage_.page_size()) {
+                flush();
+                next_page();
+            }
+            if (batchSize_ + size > BatchSize) { flush(); }
+
+            const auto length = static_cast<char>(line.size());
+            if (size > BatchSize) {
+                // Lines longer than a batch are programmed on their own, the inverted length last
+                storage_.program(page_, pagePos_, std::span<const char>{&length, 1});
+                storage_.program(page_, pagePos_ + 1, std::span<const char>{line});
+                const auto inverted = static_cast<char>(~length);
+                storage_.program(page_, pagePos_ + 1 + line.size(), std::span<const char>{&inverted, 1});
+                pagePos_ += size;
+                return;
+            }
+            batch_[batchSize_] = length;
+            std::copy(line.begin(), line.end(), &batch_[batchSize_ + 1]);
+            batch_[batchSize_ + size - 1] = static_cast<char>(~length);
+            batchSize_ += size;
+        }
+
+        /// \brief Programs the lines collected in the batch
+        void flush() {
+            if (batchSize_ == 0) { return; }
+            storage_.program(page_, pagePos_, std::span<const char>{batch_, batchSize_});
+            pagePos_ += batchSize_;
+            batchSize_ = 0;
+        }
+
+        /// \brief Passes each stored line to a function, from the oldest line to the newest
+        /// \tparam F Called with a `std::string_view` of each line
+        template<class F>
+        void replay(F &&f) {
+            open();
+            flush();
+            const auto count = storage_.page_count();
+            // The page after the newest is the oldest, unless it has not been written yet
+            for (std::size_t i = 1; i <= count; ++i) {
+                auto page = (page_ + i) % count;
+                std::uint32_t seq;
+                if (read_header(page, seq) && seq == seq_ - static_cast<std::uint32_t>(count - i)) {
+                    scan(page, f);
+                }
+            }
+        }
+
+    private:
+        static constexpr char magic_[2] = {'h', 'l'};
+
+        Storage &storage_;
+        char batch_[BatchSize]{};
+        std::size_t batchSize_{0};
+        std::size_t page_{0};
+        std::size_t pagePos_{0};
+        std::uint32_t seq_{0};
+        bool opened_{false};
+
+        /// \brief Finds the newest page and where its records end
+        void open() {
+            if (opened_) { return; }
+            opened_ = true;
+
+            bool found = false;
+            for (std::size_t page = 0; page < storage_.page_count(); ++page) {
+                std::uint32_t seq;
+                if (read_header(page, seq) && (!found || seq - seq_ < 0x80000000u)) {
+                    found = true;
+                    page_ = page;
+                    seq_ = seq;
+                }
+            }
+            if (!found) {
+                page_ = storage_.page_count() - 1;
+                seq_ = static_cast<std::uint32_t>(-1);
+                next_page();
+                return;
+            }
+            // A record cut short leaves chars that are not erased after it, so the rest of the page is skipped
+            bool whole = true;
+            pagePos_ = scan(page_, [](std::string_view) {}, &whole);
+            if (!whole) { pagePos_ = storage_.page_size(); }
+        }
+
+        /// \brief Erases the page after the newest and starts it with the next sequence number
+        void next_page() {
+            page_ = (page_ + 1) % storage_.page_count();
+            ++seq_;
+            storage_.erase(page_);
+            char header[header_size] = {magic_[0], magic_[1]};
+            for (std::size_t i = 0; i < 4; ++i) { header[2 + i] = static_cast<char>(seq_ >> (8 * i)); }
+            storage_.program(page_, 0, std::span<const char>{header});
+            pagePos_ = header_size;
+        }
+
+        bool read_header(std::size_t page, std::uint32_t &seq) {
+            char header[header_size];
+            storage_.read(page, 0, std::span<char>{header});
+            if (header[0] != magic_[0] || header[1] != magic_[1]) { return false; }
+            seq = 0;
+            for (std::size_t i = 0; i < 4; ++i) {
+                seq |= static_cast<std::uint32_t>(static_cast<unsigned char>(header[2 + i])) << (8 * i);
+            }
+            return true;
+        }
+
+        /// \brief Passes each whole record of a page to a function
+        /// \param whole Set to false if the records end with one that was cut short
+        /// \return The offset after the last whole record
+        template<class F>
+        std::size_t scan(std::size_t page, F &&f, bool *whole = nullptr) {
+            const auto pageSize = storage_.page_size();
+            char line[MaxLine];
+            std::size_t pos = header_size;
+            while (pos + overhead <= pageSize) {
+                char length;
+                storage_.read(page, pos, std::span<char>{&length, 1});
+                if (length == '\xff') { break; }
+                auto size = static_cast<unsigned char>(length);
+                char inverted = 0;
+                if (size <= MaxLine && pos + size + overhead <= pageSize) {
+                    storage_.read(page, pos + 1 + size, std::span<char>{&inverted, 1});
+                }
+                if (inverted != static_cast<char>(~length)) {
+                    if (whole != nullptr) { *whole = false; }
+                    break;
+                }
+                storage_.read(page, pos + 1, std::span<char>{line, size});
+                f(std::string_view{line, size});
+                pos += size + overhead;
+            }
+            return pos;
+        }
+    };
+}// namespace hh::shell
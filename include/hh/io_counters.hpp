@@ -0,0 +1,101 @@
+/// \file io_counters.hpp
+/// \brief Counters for the shell's input and output, used to size buffers and find where link time goes
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <hh/command_table.hpp>
+#include <hh/concepts.hpp>
+#include <type_traits>
+
+namespace hh::shell {
+
+    /// \brief Counts of the chars passing through a shell
+    ///
+    /// Written and read by the thread running the shell.
+    struct io_counters {
+        /// \brief Chars read from the device
+        std::uint32_t rx_bytes{0};
+        /// \brief Chars written to the shell's output stream, including command output
+        std::uint32_t tx_bytes{0};
+        /// \brief The most chars read by a single `notify_rx()`
+        std::uint32_t max_rx_burst{0};
+        /// \brief Escape sequences parsed, and sequences discarded because they were malformed
+        std::uint32_t ansi_parsed{0};
+        std::uint32_t ansi_rejected{0};
+        /// \brief Chars drawing the line that echoed typed chars, and the remaining chars spent redrawing it
+        std::uint32_t echo_bytes{0};
+        std::uint32_t redraw_bytes{0};
+        /// \brief Chars added to the line since it was last drawn
+        std::uint32_t pending_echo{0};
+
+        void rx(std::size_t count) { rx_bytes += count; }
+        void tx(std::size_t count) { tx_bytes += count; }
+        void rx_burst(std::size_t count) { max_rx_burst = std::max<std::uint32_t>(max_rx_burst, count); }
+        void ansi(bool good) { ++(good ? ansi_parsed : ansi_rejected); }
+        void typed(std::size_t count) { pending_echo += count; }
+
+        /// \brief Splits the chars sent to draw the line into echo and redraw overhead
+        void rendered(std::size_t count) {
+            auto echo = std::min<std::uint32_t>(pending_echo, count);
+            echo_bytes += echo;
+            redraw_bytes += count - echo;
+            pending_echo = 0;
+        }
+
+        void reset() { *this = {}; }
+    };
+
+    /// \brief Stands in for `io_counters` when counting is turned off, so counting compiles to nothing
+    struct no_io_counters {
+        void rx(std::size_t) {}
+        void tx(std::size_t) {}
+        void rx_burst(std::size_t) {}
+        void ansi(bool) {}
+        void typed(std::size_t) {}
+        void rendered(std::size_t) {}
+        void reset() {}
+    };
+
+    /// \brief An output device that counts the chars written to another device
+    ///
+    /// If the device reports how many chars it accepted, only those are counted, and the count is returned.
+    template<serial_out_device Out, class Counters>
+    class counted_output {
+    public:
+        counted_output(Out &out, Counters &counters)
+            : out_{&out}, counters_{&counters} {}
+
+        auto write(const char *s, std::size_t count) {
+            if constexpr (std::is_void_v<decltype(out_->write(s, count))>) {
+                counters_->tx(count);
+                out_->write(s, count);
+            } else {
+                std::size_t accepted = out_->write(s, count);
+                counters_->tx(accepted);
+                return accepted;
+            }
+        }
+        void flush() { out_->flush(); }
+
+    private:
+        Out *out_;
+        Counters *counters_;
+    };
+
+    template<serial_out_device Out>
+    class counted_output<Out, no_io_counters> {
+    public:
+        counted_output(Out &out, no_io_counters &)
+            : out_{&out} {}
+
+        auto write(const char *s, std::size_t count) { return out_->write(s, count); }
+        void flush() { out_->flush(); }
+
+    private:
+        Out *out_;
+    };
+
+    /// \brief Writes a line for each counter
+    void print_io_counters(cmd_ostream &out, const io_counters &counters);
+}// namespace hh::shell
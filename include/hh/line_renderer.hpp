@@ -0,0 +1,161 @@
+/// \file line_renderer.hpp
+/// \brief Redraws an edited line with the fewest terminal writes
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+
+namespace hh::ansi {
+
+    /// \brief Keeps track of the line drawn on the terminal, and brings it up to date with a line buffer
+    ///
+    /// Edits are made to the line buffer only, `render` then compares the buffer against what was last drawn
+    /// and sends the cheapest combination of rewriting chars, erasing chars, inserting or deleting chars
+    /// (ICH/DCH) and moving the cursor. Calling `render` once after a burst of edits only sends the net change.
+    /// Columns are relative to the end of the prompt.
+    /// \tparam LineLen The maximum length of a line
+    template<std::size_t LineLen>
+    class line_renderer {
+    public:
+        line_renderer() = default;
+
+        /// \brief Updates the terminal to show a line
+        /// \tparam Stream An output stream type
+        /// \tparam Line A type providing `size()` and `operator[]`, like `std::string_view`
+        /// \param out The stream connected to the terminal
+        /// \param line The line to show
+        /// \param cursor The position of the cursor in the line
+        template<class Stream, class Line>
+        void render(Stream &out, const Line &line, std::size_t cursor) {
+            const std::size_t newLen = std::min(line.size(), LineLen);
+            cursor = std::min(cursor, newLen);
+            std::size_t prefix = 0;
+            while (prefix < newLen && prefix < drawnLen_ && line[prefix] == drawn_[prefix]) { ++prefix; }
+
+            if (prefix == newLen && prefix == drawnLen_) {
+                move_cursor(out, drawnCursor_, cursor);
+                drawnCursor_ = cursor;
+                return;
+            }
+
+            std::size_t suffix = 0;
+            const std::size_t maxSuffix = std::min(newLen, drawnLen_) - prefix;
+            while (suffix < maxSuffix && line[newLen - suffix - 1] == drawn_[drawnLen_ - suffix - 1]) { ++suffix; }
+
+            const std::size_t inserted = newLen - prefix - suffix;
+            const std::size_t deleted = drawnLen_ - prefix - suffix;
+            const std::size_t overwritten = std::min(inserted, deleted);
+
+            // Rewriting the tail of the line, then erasing whatever is left of the old line
+            const std::size_t erased = drawnLen_ > newLen ? drawnLen_ - newLen : 0;
+            const std::size_t rewriteEnd = erased > erase_with_ansi_ ? newLen : newLen + erased;
+            const std::size_t rewriteCost = (newLen - prefix) + erase_cost(erased) + move_cost(rewriteEnd, cursor);
+
+            // Only writing the changed chars, and shifting the tail with insert/delete char codes
+            std::size_t editCost = overwritten + move_cost(prefix + inserted, cursor);
+            if (inserted > deleted) {
+                editCost += (inserted - deleted) + sequence_cost(inserted - deleted);
+            } else if (deleted > inserted) {
+                editCost += sequence_cost(deleted - inserted);
+            }
+
+            move_cursor(out, drawnCursor_, prefix);
+            std::size_t column;
+            if (rewriteCost <= editCost) {
+                write_range(out, line, prefix, newLen);
+                if (erased > erase_with_ansi_) {
+                    out << "\x1b[K";
+                } else {
+                    for (std::size_t i = 0; i < erased; ++i) { out.put(' '); }
+                }
+                column = rewriteEnd;
+            } else {
+                write_range(out, line, prefix, prefix + overwritten);
+                if (inserted > deleted) {
+                    write_sequence(out, inserted - deleted, '@');
+                    write_range(out, line, prefix + overwritten, prefix + inserted);
+                } else if (deleted > inserted) {
+                    write_sequence(out, deleted - inserted, 'P');
+                }
+                column = prefix + inserted;
+            }
+
+            for (std::size_t i = prefix; i < newLen; ++i) { drawn_[i] = line[i]; }
+            drawnLen_ = newLen;
+            move_cursor(out, column, cursor);
+            drawnCursor_ = cursor;
+        }
+
+        /// \brief Marks the line on the terminal as empty, with the cursor at the start of the line
+        ///
+        /// Called after a new prompt has been written.
+        void reset() {
+            drawnLen_ = 0;
+            drawnCursor_ = 0;
+        }
+
+        [[nodiscard]] std::size_t drawn_size() const { return drawnLen_; }
+        [[nodiscard]] std::size_t drawn_cursor() const { return drawnCursor_; }
+
+    private:
+        /// Erasing more chars than this is cheaper with an erase to end of line code than with spaces
+        static constexpr std::size_t erase_with_ansi_ = 2;
+
+        char drawn_[LineLen]{};
+        std::size_t drawnLen_{0};
+        std::size_t drawnCursor_{0};
+
+        static constexpr std::size_t num_digits(std::size_t n) {
+            std::size_t digits = 1;
+            for (; n >= 10; n /= 10) { ++digits; }
+            return digits;
+        }
+
+        /// \brief The length of an escape sequence with a single count, a count of one is left out
+        static constexpr std::size_t sequence_cost(std::size_t n) {
+            return n == 1 ? 3 : 3 + num_digits(n);
+        }
+
+        static constexpr std::size_t erase_cost(std::size_t n) {
+            return n > erase_with_ansi_ ? 3 : n;
+        }
+
+        /// \brief Moving left uses backspaces and moving right rewrites chars when shorter than an escape sequence
+        static constexpr std::size_t move_cost(std::size_t from, std::size_t to) {
+            auto n = from > to ? from - to : to - from;
+            return std::min(n, sequence_cost(n));
+        }
+
+        template<class Stream>
+        static void write_sequence(Stream &out, std::size_t n, char control_char) {
+            out << "\x1b[";
+            if (n != 1) { out << n; }
+            out << control_char;
+        }
+
+        template<class Stream, class Line>
+        static void write_range(Stream &out, const Line &line, std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; ++i) { out.put(line[i]); }
+        }
+
+        template<class Stream>
+        void move_cursor(Stream &out, std::size_t from, std::size_t to) const {
+            if (to < from) {
+                auto n = from - to;
+                if (n <= sequence_cost(n)) {
+                    for (std::size_t i = 0; i < n; ++i) { out.put('\b'); }
+                } else {
+                    write_sequence(out, n, 'D');
+                }
+            } else if (to > from) {
+                // Only moves over chars already drawn, so they can be rewritten
+                auto n = to - from;
+                if (n <= sequence_cost(n)) {
+                    for (std::size_t i = from; i < to; ++i) { out.put(drawn_[i]); }
+                } else {
+                    write_sequence(out, n, 'C');
+                }
+            }
+        }
+    };
+}// namespace hh::ansi
@@ -0,0 +1,67 @@
+/// \file lock.hpp
+/// \brief Locking policies for output shared between threads
+
+#pragma once
+#include <concepts>
+#include <hh/concepts.hpp>
+
+namespace hh::shell {
+
+    /// \brief The default locking policy, does nothing so single threaded builds pay nothing for locking
+    struct null_lock {
+        void lock() {}
+        void unlock() {}
+    };
+
+    /// \brief The lock used by writers that are not given one, a single instance for each locking policy
+    ///
+    /// Locks are held by reference, so mutexes that cannot be copied can be used. Writers sharing a device
+    /// with the same policy type lock this same instance unless they are given another.
+    template<basic_lockable Lock>
+    inline Lock default_lock{};
+
+    /// \brief A reference to a lock of any policy, for code that is not a template on the policy
+    ///
+    /// A default constructed reference refers to no lock, and does nothing.
+    class lock_ref {
+    public:
+        lock_ref() = default;
+
+        template<basic_lockable Lock>
+            requires(!std::same_as<Lock, lock_ref>)
+        explicit lock_ref(Lock &lock)
+            : lock_{&lock},
+              lockFn_{[](void *l) { static_cast<Lock *>(l)->lock(); }},
+              unlockFn_{[](void *l) { static_cast<Lock *>(l)->unlock(); }} {}
+
+        void lock() {
+            if (lock_ != nullptr) { lockFn_(lock_); }
+        }
+        void unlock() {
+            if (lock_ != nullptr) { unlockFn_(lock_); }
+        }
+
+        /// \brief Checks if two references refer to the same lock
+        bool operator==(const lock_ref &other) const { return lock_ == other.lock_; }
+
+    private:
+        void *lock_{nullptr};
+        void (*lockFn_)(void *){nullptr};
+        void (*unlockFn_)(void *){nullptr};
+    };
+
+    /// \brief Holds a lock for the lifetime of the guard
+    template<basic_lockable Lock>
+    class lock_guard {
+    public:
+        explicit lock_guard(Lock &lock)
+            : lock_{lock} { lock_.lock(); }
+        ~lock_guard() { lock_.unlock(); }
+
+        lock_guard(const lock_guard &) = delete;
+        lock_guard &operator=(const lock_guard &) = delete;
+
+    private:
+        Lock &lock_;
+    };
+}// namespace hh::shell
@@ -4,11 +4,14 @@
 
 #pragma once
 #include <cmath>
+#include <concepts>
 #include <cstdint>
 #include <cstring>
 #include <hh/concepts.hpp>
 #include <hh/hal_assert.hpp>
+#include <hh/lock.hpp>
 #include <limits>
+#include <string_view>
 
 namespace hh::shell {
 
@@ -100,11 +103,75 @@ namespace hh::shell {
         iostate state_{};
     };
 
-    template<serial_out_device Out>
+    /// \brief A type erased reference to an output device or stream
+    ///
+    /// Lets code that is not templated on the device type, like shell commands, write to it. Short writes by
+    /// devices that report how much they accepted, and failed writes to streams, are passed on.
+    class output_sink {
+    public:
+        template<class Out>
+        explicit output_sink(Out &out)
+            : out_{&out},
+              write_{[](void *o, const char *s, std::size_t count) -> std::size_t {
+                  auto &out = *static_cast<Out *>(o);
+                  if constexpr (std::derived_from<Out, mini_basic_ios>) {
+                      out.write(s, count);
+                      if (!out.bad()) { return count; }
+                      out.clear(static_cast<mini_basic_ios::iostate>(out.rdstate() & ~mini_basic_ios::badbit));
+                      return 0;
+                  } else if constexpr (std::convertible_to<decltype(out.write(s, count)), std::size_t>) {
+                      return out.write(s, count);
+                  } else {
+                      out.write(s, count);
+                      return count;
+                  }
+              }},
+              flush_{[](void *o) { static_cast<Out *>(o)->flush(); }} {}
+
+        /// \return The number of chars the output accepted
+        std::size_t write(const char *s, std::size_t count) { return write_(out_, s, count); }
+        void flush() { flush_(out_); }
+
+    private:
+        void *out_;
+        std::size_t (*write_)(void *, const char *, std::size_t);
+        void (*flush_)(void *);
+    };
+
+    /// \brief An output stream writing to a serial output device
+    ///
+    /// Writes made through a `message` hold the stream's lock for the whole message, so messages from
+    /// several streams sharing a lock and a device are never interleaved. Other writes do not lock.
+    /// \tparam Out The output device type
+    /// \tparam Lock The locking policy, held by reference
+    template<serial_out_device Out, basic_lockable Lock = null_lock>
     class oserial_stream : public mini_basic_ios {
     public:
-        explicit oserial_stream(Out &out)
-            : output_{out} {}
+        /// \brief A sequence of writes made while holding the stream's lock
+        ///
+        /// The lock is taken once when the message is created and released when it is destroyed, so a
+        /// message written as a single statement, `os.begin_message() << a << b;`, is locked once.
+        class message {
+        public:
+            explicit message(oserial_stream &os)
+                : os_{os} { os_.lock_.lock(); }
+            ~message() { os_.lock_.unlock(); }
+
+            message(const message &) = delete;
+            message &operator=(const message &) = delete;
+
+            template<class T>
+            message &operator<<(const T &value) {
+                os_ << value;
+                return *this;
+            }
+
+        private:
+            oserial_stream &os_;
+        };
+
+        explicit oserial_stream(Out &out, Lock &lock = default_lock<Lock>)
+            : output_{out}, lock_{lock} {}
 
         // Not movable or copyable
         oserial_stream(const oserial_stream &) = delete;
@@ -120,6 +187,14 @@ namespace hh::shell {
             return *this;
         }
 
+        /// \brief String view stream inserter operator
+        /// \param string a string view, need not be null terminated
+        /// \return `*this`
+        oserial_stream &operator<<(std::string_view string) {
+            write(string.data(), string.size());
+            return *this;
+        }
+
         /// \brief Char stream inserter operator
         /// \param ch a charter
         /// \return `*this`
@@ -144,16 +219,18 @@ namespace hh::shell {
         /// \param ch The char
         /// \return `*this`
         oserial_stream &put(char ch) {
-            output_.write(&ch, 1);
+            write_output(&ch, 1);
             return *this;
         }
 
         /// \brief Writes a char array to the output buffer
+        ///
+        /// If the device reports accepting fewer chars than were written, `badbit` is set.
         /// \param s The char buffer
         /// \param count The size of the char buffer
         /// \return `*this`
         oserial_stream &write(const char *s, streamsize count) {
-            output_.write(s, count);
+            write_output(s, count);
             return *this;
         }
 
@@ -167,8 +244,20 @@ namespace hh::shell {
             return *this;
         }
 
+        /// \brief Starts a message, holding the stream's lock until the message is destroyed
+        [[nodiscard]] message begin_message() { return message{*this}; }
+
     private:
         Out &output_;
+        Lock &lock_;
+
+        void write_output(const char *s, streamsize count) {
+            if constexpr (std::convertible_to<decltype(output_.write(s, count)), std::size_t>) {
+                if (output_.write(s, count) < count) { setstate(badbit); }
+            } else {
+                output_.write(s, count);
+            }
+        }
         static constexpr char ascii_digits[] = "0123456789abcdef";
 
         [[nodiscard]] std::size_t get_base() {
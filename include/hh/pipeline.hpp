@@ -0,0 +1,281 @@
+/// \file pipeline.hpp
+/// \brief Runs chains of commands, streaming each command's output into the next through a ring buffer
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <hh/command_stats.hpp>
+#include <hh/command_table.hpp>
+#include <hh/command_task.hpp>
+#include <hh/ring_buffer.hpp>
+#include <span>
+#include <utility>
+
+namespace hh::shell {
+
+    /// \brief A command and its arguments, one stage of a pipeline
+    struct pipeline_stage {
+        const command *cmd{nullptr};
+        command::argv_type argv{};
+    };
+
+    /// \brief Runs the commands of a pipeline as cooperating producers and consumers
+    ///
+    /// Each stage's output is written to a fixed size pipe, which is read by the next stage with
+    /// `next_char`, so output never has to be held in full. When a pipe fills, the writer runs the reading
+    /// stage until it has taken everything, or stops waiting for input. Stages are started last first, so
+    /// every reader is waiting before its writer starts. When a stage finishes, the next stage receives
+    /// `end_of_input` once it has read what is left in its pipe.
+    ///
+    /// Only coroutine commands can read their input, the input of other commands is discarded, as is
+    /// output written to a full pipe whose reader is not waiting for input. Coroutine writers wait for space
+    /// with `tx_ready`, which resumes them once the next stage has emptied their pipe.
+    ///
+    /// With a `command_timer`, the time each stage runs for is summed over every time it is resumed, excluding
+    /// the time spent running the stages it fed, and recorded once in the stage's command statistics when it
+    /// finishes or is cancelled.
+    /// \tparam MaxStages The maximum number of commands in a pipeline, with 1 no RAM is taken by pipes
+    /// \tparam PipeSize The number of chars each pipe holds
+    /// \tparam Timer The timer used to time stages, or `no_command_timer`
+    template<std::size_t MaxStages, std::size_t PipeSize, class Timer = no_command_timer>
+    class pipeline {
+    public:
+        static_assert(MaxStages > 0, "pipelines need at least one stage");
+
+        pipeline() {
+            for (std::size_t i = 0; i < MaxStages - 1; ++i) {
+                pipes_[i].end.owner = this;
+                pipes_[i].end.index = i;
+            }
+        }
+
+        // Pipes hold pointers to the pipeline
+        pipeline(const pipeline &) = delete;
+        pipeline &operator=(const pipeline &) = delete;
+
+        [[nodiscard]] static constexpr std::size_t max_stages() { return MaxStages; }
+
+        /// \brief Sets where the run times of commands are recorded
+        /// \param commands The command table the stages' commands are from
+        /// \param stats The statistics of each command, in the same order as the commands
+        void set_stats(command_set commands, std::span<command_stats> stats) {
+            commands_ = commands;
+            stats_ = stats;
+        }
+
+        /// \brief Starts running a pipeline, the last stage writes to the given stream
+        ///
+        /// Stages that are not coroutines run to completion before this returns.
+        /// \return false if there were not enough free coroutine frames, no stage is left running
+        bool start(std::span<const pipeline_stage> stages, cmd_ostream &out) {
+            cancel();
+            numStages_ = stages.size();
+            result_ = 0;
+            std::fill_n(finished_, numStages_, false);
+            std::fill_n(ticks_, numStages_, 0);
+            for (auto i = numStages_; i-- > 0;) {
+                const auto &[cmd, argv] = stages[i];
+                cmds_[i] = cmd;
+                auto &stageOut = i + 1 == numStages_ ? out : pipes_[i].out;
+                if (cmd->execute_async == nullptr) {
+                    int result;
+                    timed(i, [&] { result = cmd->execute(argv, stageOut); });
+                    if (i + 1 == numStages_) { result_ = result; }
+                    finished_[i] = true;
+                    record(i);
+                    pump(i + 1);
+                    continue;
+                }
+                timed(i, [&] { tasks_[i] = cmd->execute_async(argv, stageOut); });
+                if (!tasks_[i].valid()) {
+                    cancel();
+                    return false;
+                }
+                if (!tasks_[i].running()) {
+                    finish(i);
+                } else {
+                    pump(i + 1);
+                }
+            }
+            return true;
+        }
+
+        /// \brief Checks if any stage is still running
+        [[nodiscard]] bool running() const {
+            for (std::size_t i = 0; i < numStages_; ++i) {
+                if (tasks_[i].running()) { return true; }
+            }
+            return false;
+        }
+
+        /// \brief The value returned by the last stage
+        [[nodiscard]] int result() const { return result_; }
+
+        /// \brief Checks if the first stage is waiting for input from the terminal
+        [[nodiscard]] bool waiting_for_input() const { return waiting_for(0, wait_reason::input); }
+
+        /// \brief Passes a char from the terminal to the first stage, which must be waiting for input
+        void input(char ch) {
+            resume_with(0, static_cast<unsigned char>(ch));
+            pump(1);
+        }
+
+        /// \brief Passes `end_of_input` to the first stage, which must be waiting for input
+        void end_input() {
+            resume_with(0, end_of_input);
+            pump(1);
+        }
+
+        /// \brief Advances the time seen by stages by one tick, resuming the ones that have slept
+        void tick() {
+            for (std::size_t i = 0; i < numStages_; ++i) {
+                if (waiting_for(i, wait_reason::ticks) && --tasks_[i].promise().ticks == 0) {
+                    resume(i);
+                    pump(i);
+                    pump(i + 1);
+                }
+            }
+        }
+
+        /// \brief Resumes the stages waiting for `tx_ready`, except writers whose pipes have not been emptied
+        void tx_ready() {
+            for (std::size_t i = 0; i < numStages_; ++i) {
+                if (waiting_for(i, wait_reason::tx_ready) && (i + 1 == numStages_ || pipes_[i].ring.empty())) {
+                    resume(i);
+                    pump(i);
+                    pump(i + 1);
+                }
+            }
+        }
+
+        /// \brief Destroys every stage, and empties the pipes
+        void cancel() {
+            for (std::size_t i = 0; i < numStages_; ++i) {
+                if (tasks_[i].running()) { record(i); }
+                tasks_[i].reset();
+                if (i < MaxStages - 1) { pipes_[i].ring.clear(); }
+            }
+        }
+
+    private:
+        struct pipe_end {
+            pipeline *owner{nullptr};
+            std::size_t index{0};
+
+            void write(const char *s, std::size_t count) { owner->write_pipe(index, s, count); }
+            void flush() { owner->pump(index + 1); }
+        };
+
+        struct pipe {
+            // Single stage pipelines have no pipes
+            container::ring_buffer<char, (MaxStages > 1 ? PipeSize : 1)> ring{};
+            pipe_end end{};
+            output_sink sink{end};
+            cmd_ostream out{sink};
+        };
+
+        command_task tasks_[MaxStages]{};
+        // Always at least one, so single stage pipelines still compile
+        pipe pipes_[MaxStages > 1 ? MaxStages - 1 : 1]{};
+        bool finished_[MaxStages]{};
+        const command *cmds_[MaxStages]{};
+        std::size_t numStages_{0};
+        int result_{0};
+        command_set commands_{};
+        std::span<command_stats> stats_{};
+        // Ticks spent in stages run from within the stage being timed
+        std::uint32_t nestedTicks_{0};
+        // Ticks each stage has run for so far, recorded when it finishes
+        std::uint32_t ticks_[MaxStages]{};
+
+        [[nodiscard]] command_stats *stats_for(const command *cmd) const {
+            // Commands from outside the table have no statistics
+            std::less<const command *> before{};
+            if (before(cmd, commands_.begin()) || !before(cmd, commands_.end())) { return nullptr; }
+            auto index = static_cast<std::size_t>(cmd - commands_.begin());
+            return index < stats_.size() ? &stats_[index] : nullptr;
+        }
+
+        /// \brief Runs part of a stage, adding how long it ran for to the stage's run time
+        template<class Run>
+        void timed(std::size_t i, Run run) {
+            if constexpr (command_timer<Timer>) {
+                std::uint32_t start = Timer::now();
+                auto outerNested = std::exchange(nestedTicks_, 0);
+                run();
+                std::uint32_t elapsed = static_cast<std::uint32_t>(Timer::now()) - start;
+                ticks_[i] += elapsed - nestedTicks_;
+                nestedTicks_ = outerNested + elapsed;
+            } else {
+                run();
+            }
+        }
+
+        /// \brief Records one run of a stage that has finished
+        void record(std::size_t i) {
+            if constexpr (command_timer<Timer>) {
+                if (auto stats = stats_for(cmds_[i]); stats != nullptr) { stats->record(ticks_[i]); }
+            }
+        }
+
+        [[nodiscard]] bool waiting_for(std::size_t i, wait_reason reason) const {
+            return tasks_[i].running() && tasks_[i].promise().waiting == reason;
+        }
+
+        void write_pipe(std::size_t index, const char *s, std::size_t count) {
+            auto &ring = pipes_[index].ring;
+            for (std::size_t i = 0; i < count;) {
+                if (ring.full()) { pump(index + 1); }
+                // Still full if the reader is not waiting for input, there is nowhere to put the next char
+                auto n = ring.push(std::span<const char>{s + i, count - i});
+                i += n > 0 ? n : 1;
+            }
+        }
+
+        /// \brief Runs a stage for as long as it reads input, and there is input in its pipe
+        ///
+        /// Called when the stage's writer writes to a full pipe, suspends or finishes, and when the stage has
+        /// been resumed for something else, as it may now be waiting for input already in its pipe. A writer waiting
+        /// for `tx_ready` is resumed each time the stage empties its pipe, so it can write more.
+        void pump(std::size_t i) {
+            if (i == 0 || i >= numStages_) { return; }
+            auto &ring = pipes_[i - 1].ring;
+            while (true) {
+                bool read = false;
+                while (waiting_for(i, wait_reason::input) && !ring.empty()) {
+                    resume_with(i, static_cast<unsigned char>(ring.pop()));
+                    read = true;
+                }
+                if (!read || !ring.empty() || !waiting_for(i - 1, wait_reason::tx_ready)) { break; }
+                resume(i - 1);
+            }
+
+            if (!tasks_[i].running()) {
+                ring.clear();
+            } else if (ring.empty() && finished_[i - 1] && waiting_for(i, wait_reason::input)) {
+                resume_with(i, end_of_input);
+            }
+        }
+
+        void resume_with(std::size_t i, int input) {
+            tasks_[i].promise().input = input;
+            resume(i);
+        }
+
+        void resume(std::size_t i) {
+            timed(i, [&] { tasks_[i].resume(); });
+            if (!tasks_[i].running()) { finish(i); }
+        }
+
+        void finish(std::size_t i) {
+            if (i + 1 == numStages_) { result_ = tasks_[i].result(); }
+            finished_[i] = true;
+            record(i);
+            // Frees the coroutine frame as soon as possible, for other commands
+            tasks_[i].reset();
+            pump(i + 1);
+        }
+    };
+}// namespace hh::shell
@@ -0,0 +1,183 @@
+/// \file ring_buffer.hpp
+/// \brief Fixed capacity first in first out queue
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+
+namespace hh::container {
+
+    /// \brief How a ring buffer is shared between threads
+    enum class ring_sync {
+        /// \brief Used by a single thread, or under a lock
+        none,
+        /// \brief Pushed to by one thread or interrupt, and popped from by one other, without locks
+        ///
+        /// Each side only writes its own index, with plain aligned loads and stores, so no read-modify-write
+        /// instructions are needed. This suits Cortex-M0 cores, which do not have LDREX/STREX.
+        spsc,
+    };
+
+    /// \brief A fixed capacity FIFO queue stored in place, without allocating
+    ///
+    /// The front and back are kept as indexes that count up to twice the capacity before wrapping, so a full
+    /// queue can be told apart from an empty one without a separate size, and without a division. With
+    /// `ring_sync::spsc`, functions that add elements may only be called by the producer, and functions that
+    /// remove them only by the consumer, and `size()` is a snapshot that may be out of date.
+    /// \tparam T The element type
+    /// \tparam N The maximum number of elements
+    /// \tparam Sync Whether the producer and consumer are different threads or interrupts
+    template<class T, std::size_t N, ring_sync Sync = ring_sync::none>
+    class ring_buffer {
+        static constexpr bool spsc_ = Sync == ring_sync::spsc;
+
+    public:
+        static_assert(N > 0, "ring buffers need space for at least one element");
+
+        using value_type = T;
+        using size_type = std::size_t;
+
+        constexpr ring_buffer() = default;
+
+        [[nodiscard]] constexpr size_type size() const { return distance(load(head_), load(tail_)); }
+        [[nodiscard]] constexpr bool empty() const { return size() == 0; }
+        [[nodiscard]] constexpr bool full() const { return size() == N; }
+        [[nodiscard]] static constexpr size_type capacity() { return N; }
+
+        /// \brief Adds an element to the back of the queue
+        /// \return false if the queue is full
+        constexpr bool push(const value_type &value) {
+            const auto tail = load(tail_, std::memory_order_relaxed);
+            if (distance(load(head_), tail) == N) { return false; }
+            buffer_[slot(tail)] = value;
+            store(tail_, advance(tail, 1));
+            return true;
+        }
+
+        /// \brief Adds as many elements as fit to the back of the queue
+        /// \return The number of elements added
+        constexpr size_type push(std::span<const value_type> values) {
+            size_type count = 0;
+            while (count < values.size()) {
+                auto segment = back_segment();
+                if (segment.empty()) { break; }
+                auto n = std::min(segment.size(), values.size() - count);
+                std::copy_n(values.data() + count, n, segment.data());
+                commit(n);
+                count += n;
+            }
+            return count;
+        }
+
+        /// \brief The free space after the back of the queue that is stored contiguously
+        ///
+        /// Elements written here, for example by DMA, are added to the queue by `commit()`. Space left at the
+        /// start of the storage is returned once these have been committed.
+        [[nodiscard]] constexpr std::span<value_type> back_segment() {
+            const auto tail = load(tail_, std::memory_order_relaxed);
+            const auto free = N - distance(load(head_), tail);
+            return {&buffer_[slot(tail)], std::min(free, N - slot(tail))};
+        }
+
+        /// \brief Adds elements written to the back segment to the queue, there must be space for count elements
+        constexpr void commit(size_type count) {
+            store(tail_, advance(load(tail_, std::memory_order_relaxed), count));
+        }
+
+        /// \brief The element at the front of the queue, the queue must not be empty
+        [[nodiscard]] constexpr const value_type &front() const {
+            return buffer_[slot(load(head_, std::memory_order_relaxed))];
+        }
+
+        /// \brief The element at a position from the front of the queue, there must be more than pos elements
+        [[nodiscard]] constexpr const value_type &operator[](size_type pos) const {
+            return buffer_[slot(advance(load(head_, std::memory_order_relaxed), pos))];
+        }
+        [[nodiscard]] constexpr value_type &operator[](size_type pos) {
+            return buffer_[slot(advance(load(head_, std::memory_order_relaxed), pos))];
+        }
+
+        /// \brief Removes and returns the element at the front of the queue, the queue must not be empty
+        constexpr value_type pop() {
+            const auto head = load(head_, std::memory_order_relaxed);
+            auto value = buffer_[slot(head)];
+            store(head_, advance(head, 1));
+            return value;
+        }
+
+        /// \brief Removes elements from the front of the queue into a buffer, until either is empty
+        /// \return The number of elements removed
+        constexpr size_type pop(std::span<value_type> values) {
+            size_type count = 0;
+            while (count < values.size()) {
+                auto segment = front_segment();
+                if (segment.empty()) { break; }
+                auto n = std::min(segment.size(), values.size() - count);
+                std::copy_n(segment.data(), n, values.data() + count);
+                consume(n);
+                count += n;
+            }
+            return count;
+        }
+
+        /// \brief The elements from the front of the queue that are stored contiguously
+        ///
+        /// Holds every element unless the elements wrap around the end of the storage, in which case the rest
+        /// are in the next segment, returned once these have been consumed.
+        [[nodiscard]] constexpr std::span<const value_type> front_segment() const {
+            const auto head = load(head_, std::memory_order_relaxed);
+            return {&buffer_[slot(head)], std::min(distance(head, load(tail_)), N - slot(head))};
+        }
+
+        /// \brief Removes elements from the front of the queue, there must be at least count elements
+        constexpr void consume(size_type count) {
+            store(head_, advance(load(head_, std::memory_order_relaxed), count));
+        }
+
+        /// \brief Removes every element, only from the consumer with `ring_sync::spsc`
+        constexpr void clear() { store(head_, load(tail_)); }
+
+    private:
+        // Shared indexes are plain words rather than std::atomic, which is not always lock-free on cores
+        // without LDREX/STREX, such as Cortex-M0, even though aligned word loads and stores are atomic there
+        using index_type = std::conditional_t<spsc_, volatile size_type, size_type>;
+        static_assert(!spsc_ || (sizeof(size_type) <= sizeof(void *) && alignof(size_type) == sizeof(size_type)),
+                      "lock-free rings need indexes that are loaded and stored in one instruction");
+
+        value_type buffer_[N]{};
+        // The consumer writes head_ and the producer writes tail_, both count to 2N so a full ring has tail_
+        // N ahead of head_
+        index_type head_{0};
+        index_type tail_{0};
+
+        /// \brief Reads an index, by default acquiring the elements the other side released with it
+        static constexpr size_type load(const index_type &index,
+                                        std::memory_order order = std::memory_order_acquire) {
+            const size_type value = index;
+            if constexpr (spsc_) {
+                if (order != std::memory_order_relaxed) { std::atomic_thread_fence(order); }
+            }
+            return value;
+        }
+
+        /// \brief Writes an index, releasing the elements written or read before it to the other side
+        static constexpr void store(index_type &index, size_type value) {
+            if constexpr (spsc_) { std::atomic_thread_fence(std::memory_order_release); }
+            index = value;
+        }
+
+        [[nodiscard]] static constexpr size_type slot(size_type index) { return index < N ? index : index - N; }
+
+        [[nodiscard]] static constexpr size_type advance(size_type index, size_type count) {
+            index += count;
+            return index < 2 * N ? index : index - 2 * N;
+        }
+
+        [[nodiscard]] static constexpr size_type distance(size_type head, size_type tail) {
+            return tail >= head ? tail - head : tail + 2 * N - head;
+        }
+    };
+}// namespace hh::container
@@ -0,0 +1,72 @@
+/// \file serial_queue.hpp
+/// \brief A serial device over lock-free queues, filled and drained by UART interrupts
+
+#pragma once
+#include <cstddef>
+#include <hh/ring_buffer.hpp>
+#include <span>
+#include <string>
+
+namespace hh::shell {
+
+    /// \brief Passes chars between UART interrupts and a shell through single producer single consumer queues
+    ///
+    /// The receive interrupt pushes received chars to the rx queue, one at a time or by DMA into its
+    /// `back_segment()`, and the main loop then calls `shell::notify_rx()`, which reads them in bulk. Output is
+    /// pushed to the tx queue, and the transmit interrupt drains it, one char at a time with `pop()` or by DMA
+    /// from its `front_segment()`. Neither side locks or disables interrupts.
+    ///
+    /// The queues are owned by the application, so the interrupt handlers can reach them, and the device is
+    /// only a pair of pointers that can be moved into a shell.
+    /// \tparam RxSize The number of received chars held until the shell reads them
+    /// \tparam TxSize The number of chars of output held until they are transmitted
+    template<std::size_t RxSize, std::size_t TxSize>
+    class serial_queue {
+    public:
+        using rx_queue = container::ring_buffer<char, RxSize, container::ring_sync::spsc>;
+        using tx_queue = container::ring_buffer<char, TxSize, container::ring_sync::spsc>;
+
+        /// \param startTx Called after output is queued, to enable the transmit interrupt or start a DMA
+        /// transfer if one is not already running
+        serial_queue(rx_queue &rx, tx_queue &tx, void (*startTx)() = nullptr)
+            : rx_{&rx}, tx_{&tx}, startTx_{startTx} {}
+
+        /// \return The next received char, or EOF if none has been received
+        int get() {
+            if (rx_->empty()) { return std::char_traits<char>::eof(); }
+            return static_cast<unsigned char>(rx_->pop());
+        }
+
+        /// \brief Copies up to count received chars, without waiting for more
+        std::size_t read(char *s, std::size_t count) { return rx_->pop(std::span<char>{s, count}); }
+
+        /// \brief Queues as many chars as fit without waiting
+        /// \return The number of chars queued
+        std::size_t try_write(const char *s, std::size_t count) {
+            auto n = tx_->push(std::span<const char>{s, count});
+            if (n > 0) { start_tx(); }
+            return n;
+        }
+
+        /// \brief Queues every char, waiting for the transmit interrupt to make space
+        void write(const char *s, std::size_t count) {
+            while (count > 0) {
+                auto n = try_write(s, count);
+                s += n;
+                count -= n;
+            }
+        }
+
+        /// \brief Output is transmitted as it is queued, there is nothing to flush
+        void flush() {}
+
+    private:
+        rx_queue *rx_;
+        tx_queue *tx_;
+        void (*startTx_)();
+
+        void start_tx() {
+            if (startTx_ != nullptr) { startTx_(); }
+        }
+    };
+}// namespace hh::shell
@@ -1,67 +1,469 @@
 /// \file shell.hpp
 /// \brief Created on 2021-08-30 by Ben
-/// \todo Run commands
 
 
 #pragma once
+#include <algorithm>
 #include <cctype>
 #include <hh/ansi_codes.hpp>
 #include <hh/ansi_parser.hpp>
 #include <hh/cmd_history.hpp>
-#include <hh/fixed_string.h>
+#include <hh/command_table.hpp>
+#include <hh/completion_trie.hpp>
+#include <hh/framing.hpp>
+#include <hh/gap_buffer.hpp>
+#include <hh/history_log.hpp>
+#include <hh/io_counters.hpp>
+#include <hh/line_renderer.hpp>
 #include <hh/mini_stream.hpp>
+#include <hh/pipeline.hpp>
+#include <hh/ring_buffer.hpp>
+#include <hh/tokenizer.hpp>
+#include <hh/tx_ring.hpp>
+#include <hh/typed_command.hpp>
+#include <hh/write_buffer.hpp>
 #include <string>
 
 namespace hh::shell {
 
-    template<serial_io_device IO, std::size_t NumLines, std::size_t LineLen>
+    /// \brief Compile time shell settings, derive from this struct to override individual settings
+    struct shell_config {
+        /// \brief The maximum number of arguments passed to a command, including the command name
+        static constexpr std::size_t max_args = 8;
+        /// \brief The number of chars read at once from devices that support bulk reads
+        static constexpr std::size_t rx_chunk_size = 32;
+        /// \brief The size of the buffer output is collected in before being written to the device
+        static constexpr std::size_t tx_buffer_size = 64;
+        /// \brief The locking policy held while writing to the device
+        ///
+        /// Shells lock the `default_lock` instance of the policy, so sessions and other writers sharing a device
+        /// with the same policy lock the same mutex. The output of each event, such as the chars received in
+        /// one `notify_rx()`, is written as a single locked message. A second instance of the policy guards the
+        /// pool of coroutine frames, see `attach_frame_pool`.
+        using lock_type = null_lock;
+        /// \brief Start in batch mode, where lines are run without echo, history or prompts
+        static constexpr bool batch_mode = false;
+        /// \brief The maximum number of commands chained with `|` in one line, 1 leaves pipelines disabled
+        ///
+        /// Each pipe between two stages takes `pipe_size` chars of RAM.
+        static constexpr std::size_t max_pipeline_stages = 1;
+        /// \brief The number of chars buffered between each pair of piped commands
+        static constexpr std::size_t pipe_size = 64;
+        /// \brief The timer used to record how long commands run for, see `command_timer`
+        ///
+        /// With the default no time is spent timing commands, and the `stats` command is not available.
+        using command_timer = no_command_timer;
+        /// \brief Count the chars passing through the shell, printed by the built in `iostat` command
+        static constexpr bool io_counters = false;
+        /// \brief The number of chars of log lines that can be queued to be printed above the prompt, 0 leaves
+        /// `log()` disabled
+        static constexpr std::size_t log_buffer_size = 0;
+        /// \brief The size of the ring output is held in for non-blocking devices, see `tx_ring`
+        ///
+        /// With the default of 0, output is written with blocking writes through the `tx_buffer_size` buffer.
+        /// Otherwise the device must provide `try_write`, and commands waiting for `tx_ready` are only resumed
+        /// while the ring is below the high water mark. Output that does not fit in the ring is dropped, and the
+        /// line being typed is then drawn again.
+        static constexpr std::size_t tx_ring_size = 0;
+        /// \brief The number of buffered chars at which commands stop being resumed, 0 for 3/4 of the ring
+        static constexpr std::size_t tx_high_water = 0;
+        /// \brief Pause output on XOFF (Ctrl-S) and resume it on XON (Ctrl-Q), needs a `tx_ring_size`
+        static constexpr bool xon_xoff = false;
+        /// \brief The largest decoded packet of the binary protocol, 0 leaves it disabled
+        ///
+        /// Frames start and end with a zero byte, and hold a COBS encoded packet: a sequence ID, the arguments
+        /// as a length byte followed by that many bytes, and a little endian CRC-16 of the rest of the packet.
+        /// The command is run from the command table without echo or prompts, and answered with a packet
+        /// holding the same sequence ID, the 32 bit little endian status, the command's output, and a CRC.
+        /// Frames too long to hold a packet of this size are dropped, and the chars after them are handled as
+        /// usual, so a stray zero byte typed at a terminal swallows at most that many chars.
+        static constexpr std::size_t frame_size = 0;
+        /// \brief The number of chars received while a command runs that are queued to be processed after it
+        ///
+        /// Lets hosts send several lines without waiting for each prompt, tagging each with a `#<id>` prefix to
+        /// match it to its `#<id>=<status>` line. With the default of 0, chars are passed to the command if it
+        /// is waiting for input and are otherwise dropped, or held in the device in batch mode. A line that
+        /// does not fit is dropped whole, along with the lines after it, and reported with `status_queue_full`.
+        static constexpr std::size_t line_queue_size = 0;
+        /// \brief The number of slots in the history's hash index, a power of two, see `cmd_history`
+        ///
+        /// With the default of 0, a line already in the history is found by comparing every line, which is
+        /// fast enough for small histories. Large histories, like those of host builds, should use an index.
+        static constexpr std::size_t history_index_size = 0;
+        /// \brief The storage the history is logged to so it survives a reset, see `history_log`
+        ///
+        /// With the default the history is only kept in RAM. Otherwise the shell is given a `history_log_type`
+        /// over the storage with `set_history_log`, and rebuilds the history from it when it is first used.
+        using history_storage = no_history_storage;
+        /// \brief The number of chars of history lines collected before they are written to the storage
+        static constexpr std::size_t history_batch_size = 32;
+        /// \brief Recall history lines with `!!`, `!n`, `!-n` or `!prefix` at the start of a line
+        ///
+        /// `!n` is line n listed by the built in `history` command, lines are numbered from 1 in the order they
+        /// were entered and keep their number while they are in the history. `!-n` is the line numbered n before
+        /// the next line, as in bash, and `!prefix` the newest line starting with the prefix. The rest of the line
+        /// follows the recalled line, and the expanded line is shown before it is run.
+        static constexpr bool history_expansion = false;
+        /// \brief Search the history with Ctrl-R, the query takes a line of RAM
+        static constexpr bool history_search = false;
+        /// \brief The largest coroutine frame a command may use
+        ///
+        /// Shells whose configs have the same frame settings and `lock_type` share one pool of frames. Shells
+        /// that exist at the same time must share it, see `attach_frame_pool`.
+        static constexpr std::size_t command_frame_size = default_command_frame_size;
+        /// \brief The number of coroutine commands that can be running at once, in every shell sharing the pool
+        static constexpr std::size_t max_command_frames = default_max_command_frames;
+    };
+
+    namespace detail {
+        /// \brief The frame pool's lock, apart from the output lock, which may be held while a command starts
+        template<basic_lockable Lock>
+        inline Lock frame_pool_lock{};
+
+        /// \brief The frames of the shells whose configs have other than the default frame settings
+        template<std::size_t FrameSize, std::size_t NumFrames>
+        inline static_frame_pool<FrameSize, NumFrames> command_frames{};
+
+        template<class IO, class Config, bool Ring = (Config::tx_ring_size > 0)>
+        struct select_tx_buffer {
+            using type = write_buffer<IO, Config::tx_buffer_size, typename Config::lock_type>;
+        };
+
+        template<class IO, class Config>
+        struct select_tx_buffer<IO, Config, true> {
+            static constexpr std::size_t high_water =
+                    Config::tx_high_water > 0 ? Config::tx_high_water : Config::tx_ring_size * 3 / 4;
+            using type = tx_ring<IO, Config::tx_ring_size, (high_water > 0 ? high_water : 1),
+                                 typename Config::lock_type>;
+        };
+
+        template<class Config, std::size_t LineLen, bool Stored = block_storage<typename Config::history_storage>>
+        struct select_history_log {
+            using type = no_history_storage;
+        };
+
+        template<class Config, std::size_t LineLen>
+        struct select_history_log<Config, LineLen, true> {
+            using type = history_log<typename Config::history_storage, LineLen, Config::history_batch_size>;
+        };
+    }// namespace detail
+
+    template<serial_io_device IO, std::size_t NumLines, std::size_t LineLen, class Config = shell_config>
     class shell {
     public:
-        using olstream = oserial_stream<IO>;
-        struct command {
-            using cmd_function = int(void *);
-            cmd_function *execute;
-            const char *cmd_name;
-            const char *help_message;
-        };
+        using lock_type = typename Config::lock_type;
+        using tx_buffer = typename detail::select_tx_buffer<IO, Config>::type;
+        using history_log_type = typename detail::select_history_log<Config, LineLen>::type;
+        using counters_type = std::conditional_t<Config::io_counters, io_counters, no_io_counters>;
+        using olstream = oserial_stream<counted_output<tx_buffer, counters_type>>;
+        using command = hh::shell::command;
 
+    private:
+        IO &io_;
+        tx_buffer txBuffer_{io_};
+        [[no_unique_address]] counters_type counters_{};
+        counted_output<tx_buffer, counters_type> txCounter_{txBuffer_, counters_};
+
+    public:
         olstream lout;
 
         explicit shell(IO &io)
-            : lout{io}, io_{io} {}
+            : io_{io}, lout{txCounter_} { attach_frame_pool(frames(), frame_lock()); }
 
-        shell(IO &io, const command *command_table, std::size_t num_cmds)
-            : io_{io}, lout{io}, commandTable_{command_table}, numCommands_{num_cmds} {}
+        shell(IO &io, command_set commands)
+            : io_{io}, lout{txCounter_}, commands_{commands} { attach_frame_pool(frames(), frame_lock()); }
+
+        shell(IO &io, command_set commands, completion_set completions)
+            : io_{io}, lout{txCounter_}, commands_{commands}, completions_{completions} {
+            attach_frame_pool(frames(), frame_lock());
+        }
+
+        // The shell's streams refer to its own buffers
+        shell(const shell &) = delete;
+        shell &operator=(const shell &) = delete;
+
+        ~shell() { detach_frame_pool(); }
 
         [[nodiscard]] std::string_view current_line() const {
-            return currentLine_.c_str();
+            return currentLine_.view();
         }
 
+        /// \brief Processes all available input
+        ///
+        /// Edits to the current line are only drawn once all input has been processed. Output produced while
+        /// processing the input is collected, and written to the device at the end, or whenever the output
+        /// buffer fills.
         void notify_rx() {
-            auto ch = io_.get();
+            counters_.rx_burst(read_input());
+            print_logs();
+            render_line();
+            txBuffer_.send();
+        }
+
+        /// \brief Resumes a running command waiting for `tx_ready`, call once the device can accept more output
+        ///
+        /// With a `tx_ring_size`, buffered output is sent first, and commands are only resumed if the ring has
+        /// drained below the high water mark and output is not paused.
+        void notify_tx_ready() {
+            if constexpr (tx_ring_) { txBuffer_.send(); }
+            if (pipeline_.running() && !tx_would_block()) {
+                pipeline_.tx_ready();
+                command_resumed();
+            }
+            // Lines held back while a command ran in batch mode can now be run
+            if (batch_) { read_input(); }
+            print_logs();
+            render_line();
+            txBuffer_.send();
+        }
+
+        /// \brief Advances the time seen by running commands by one tick, resuming them once they have slept
+        void notify_tick() {
+            if (pipeline_.running()) {
+                pipeline_.tick();
+                command_resumed();
+            }
+            if (batch_) { read_input(); }
+            print_logs();
+            render_line();
+            txBuffer_.send();
+        }
+
+        /// \brief Queues a line to be printed above the prompt, without disturbing the line being typed
+        ///
+        /// Queued lines are printed at the end of the next `notify_rx()`, `notify_tick()`, `notify_tx_ready()`
+        /// or `notify_log()`, while no command is running. All the lines queued by then are printed together,
+        /// after clearing the prompt, which is then redrawn once with the cursor where it was.
+        /// \note Must be called from the thread running the shell
+        /// \return false if there was not enough space to queue the line, or no `log_buffer_size`, and it was dropped
+        bool log(std::string_view line) {
+            if (!logged_ || logs_.capacity() - logs_.size() < line.size() + 1) { return false; }
+            logs_.push(std::span<const char>{line});
+            logs_.push('\n');
+            return true;
+        }
+
+        /// \brief Prints the queued log lines, call after queueing lines when no other events are expected
+        void notify_log() {
+            print_logs();
+            render_line();
+            txBuffer_.send();
+        }
+
+        /// \brief Switches between interactive and batch mode
+        ///
+        /// In batch mode each received line is run as soon as it ends, without echo, ANSI parsing, history or
+        /// prompts. After each line a status line of `=` followed by the command's return value, or a
+        /// `batch_status`, is sent. Blank lines report 0, and lines longer than `LineLen` are not run. Input is
+        /// not read while a coroutine command runs, unless it waits for input, so lines are run back to back in
+        /// the order they were sent. Batch mode is entered at runtime with `ESC [ b`, and left with EOT
+        /// (Ctrl-D), which shows the prompt again. Bracketed paste is turned off in the terminal while in batch
+        /// mode.
+        void set_batch_mode(bool enable) {
+            batch_ = enable;
+            batchCr_ = false;
+            batchInput_ = false;
+            batchTooLong_ = false;
+            currentLine_.clear();
+            renderer_.reset();
+            update_bracketed_paste();
+            if (!batch_) { lout << prompt_char_; }
+        }
+
+        [[nodiscard]] bool batch_mode() const { return batch_; }
+
+        /// \brief The input and output counters, needs `io_counters` set in the config
+        [[nodiscard]] const io_counters &io_stats() const {
+            static_assert(Config::io_counters, "set shell_config::io_counters to count input and output");
+            return counters_;
+        }
 
-            while (ch != eof_) {
-                process_rx_char(ch);
-                ch = io_.get();
+        /// \brief Sets where the run times of commands are recorded, needs a `command_timer` in the config
+        ///
+        /// The statistics can be read at any time, and are printed by the built in `stats` command, or
+        /// cleared by `stats reset`.
+        /// \param stats The statistics of each command, in the same order as the command table
+        void set_command_stats(std::span<command_stats> stats) {
+            static_assert(timed_, "set shell_config::command_timer to time commands");
+            stats_ = stats;
+            pipeline_.set_stats(commands_, stats);
+        }
+
+        /// \brief Sets the log the history is kept in, needs a `history_storage` in the config
+        ///
+        /// The history is rebuilt from the log the first time it is used rather than here, so that a large log
+        /// does not delay startup. Each new line is then appended to the log.
+        void set_history_log(history_log_type &log) {
+            static_assert(persistent_, "set shell_config::history_storage to keep the history in storage");
+            historyLog_ = &log;
+            historyRestored_ = false;
+        }
+
+        /// \brief Writes the history lines still collected in the log's batch, call when idle or before a reset
+        void flush_history() {
+            if constexpr (persistent_) {
+                if (historyLog_ != nullptr) { historyLog_->flush(); }
             }
         }
 
-        void notify_connected() { lout << endl
-                                       << welcome_message_ << endl
-                                       << prompt_char_; }
+        /// \brief Shows the welcome message and prompt, and turns on bracketed paste in the terminal
+        void notify_connected() {
+            pasteWanted_ = true;
+            framedHost_ = false;
+            if (batch_) { return; }
+            // A terminal connecting again has forgotten the mode
+            pasteOn_ = false;
+            update_bracketed_paste();
+            lout << endl
+                 << welcome_message_ << endl
+                 << prompt_char_;
+            renderer_.reset();
+            render_line();
+            txBuffer_.send();
+        }
+
+        /// \brief Turns off bracketed paste in the terminal, call before the link is closed or the terminal is
+        /// handed to another program
+        void notify_disconnected() {
+            pasteWanted_ = false;
+            update_bracketed_paste();
+            txBuffer_.send();
+        }
 
     private:
-        using history = cmd_history<NumLines, LineLen>;
+        using history = cmd_history<NumLines, LineLen, Config::history_index_size>;
         using int_type = std::char_traits<char>::int_type;
         using cmd_iter_type = typename history::const_iterator;
-        using string = container::fixed_string<LineLen>;
+        using line_buffer = container::gap_buffer<LineLen>;
 
         enum class parser_state {
             text,
             ansi_cmd,
         };
 
+        static frame_pool &frames() {
+            if constexpr (Config::command_frame_size == default_command_frame_size &&
+                          Config::max_command_frames == default_max_command_frames) {
+                return default_frame_pool();
+            } else {
+                return detail::command_frames<Config::command_frame_size, Config::max_command_frames>;
+            }
+        }
+
+        static lock_ref frame_lock() {
+            if constexpr (std::same_as<lock_type, null_lock>) {
+                return {};
+            } else {
+                return lock_ref{detail::frame_pool_lock<lock_type>};
+            }
+        }
+
+        /// \brief Reads and processes input until none is left, or input is held back for a running command
+        /// \return The number of chars read from the device
+        std::size_t read_input() {
+            std::size_t count = 0;
+            if constexpr (serial_bulk_in_device<IO>) {
+                while (!input_held()) {
+                    if (rxPos_ == rxSize_) {
+                        rxPos_ = 0;
+                        rxSize_ = io_.read(rxChunk_, Config::rx_chunk_size);
+                        if (rxSize_ == 0) { break; }
+                        count += rxSize_;
+                        counters_.rx(rxSize_);
+                    }
+                    rxPos_ += process_rx(&rxChunk_[rxPos_], rxSize_ - rxPos_);
+                }
+            } else {
+                while (!input_held()) {
+                    auto ch = io_.get();
+                    if (ch == eof_) { break; }
+                    ++count;
+                    counters_.rx(1);
+                    process_rx_char(static_cast<char>(ch));
+                }
+            }
+            return count;
+        }
+
+        /// \return The number of chars processed, less than count if input is held back
+        std::size_t process_rx(const char *s, std::size_t count) {
+            std::size_t i = 0;
+            while (i < count && !input_held()) {
+                if (auto n = paste(s + i, count - i); n > 0) {
+                    i += n;
+                    continue;
+                }
+                process_rx_char(s[i++]);
+            }
+            return i;
+        }
+
+        /// \brief Copies pasted text up to the next control char into the line in one insert
+        /// \return The number of chars copied, 0 if not pasting
+        std::size_t paste(const char *s, std::size_t count) {
+            if (!pasting_ || state_ != parser_state::text || pipeline_.running() || batch_ || inFrame_ || dropping_) {
+                return 0;
+            }
+            auto n = static_cast<std::size_t>(std::find_if(s, s + count, is_control) - s);
+            // Chars that do not fit in the line are dropped, as they are when typed
+            counters_.typed(currentLine_.insert(s, n));
+            return n;
+        }
+
+        /// \brief In batch mode, the following lines wait in the device once they no longer fit in the queue
+        [[nodiscard]] bool input_held() const {
+            return batch_ && pipeline_.running() && !pipeline_.waiting_for_input() && (!queued_ || lineQueue_.full());
+        }
+
+        [[nodiscard]] bool tx_would_block() const {
+            if constexpr (tx_ring_) {
+                return txBuffer_.would_block();
+            } else {
+                return false;
+            }
+        }
+
         void process_rx_char(char ch) {
+            if constexpr (Config::xon_xoff) {
+                // Flow control chars are never seen by the line editor or commands, but inside a frame they are
+                // bytes of the packet
+                if (ch == xoff_ && !inFrame_) {
+                    txBuffer_.pause();
+                    return;
+                }
+                if (ch == xon_ && !inFrame_) {
+                    txBuffer_.resume();
+                    return;
+                }
+            }
+            if constexpr (framed_) {
+                // Commands run from the terminal are given every char, including frame delimiters
+                if ((inFrame_ || (ch == frame_delimiter && (!pipeline_.running() || framedCmd_))) &&
+                    parse_frame_char(ch)) {
+                    return;
+                }
+                // Chars between frames are not passed to commands run from frames
+                if (framedCmd_) { return; }
+            }
+            if constexpr (queued_) {
+                if (dropping_ && !replaying_) {
+                    if (ch != ctrl_c_) {
+                        drop_input(ch);
+                        return;
+                    }
+                    // Ctrl-C discards the chars typed ahead anyway, and is handled as usual
+                    dropping_ = false;
+                }
+            }
+            if (pipeline_.running()) {
+                command_input(ch);
+                return;
+            }
+            if (batch_) {
+                parse_batch_char(ch);
+                return;
+            }
+
             switch (state_) {
                 case parser_state::text:
                     parse_text_char(ch);
@@ -69,8 +471,12 @@ namespace hh::shell {
                 case parser_state::ansi_cmd:
                     if (parser_.parse(ch)) {
                         state_ = parser_state::text;
-                        // handle ansi command
+                        counters_.ansi(true);
                         handle_ansi_cmd(parser_.code());
+                    } else if (!parser_.good()) {
+                        // Malformed sequences are dropped, the following chars are text again
+                        state_ = parser_state::text;
+                        counters_.ansi(false);
                     }
                     break;
             }
@@ -80,11 +486,9 @@ namespace hh::shell {
             switch (code.control_char) {
                 case 'A':
                     // up
+                    restore_history();
                     if (!onFirstCmd_) {
-                        currentLine_.clear();
-                        currentLine_.append(prevCommand_->data());
-                        lout << ansi::clear_line << prompt_char_;
-                        lout << prevCommand_->data();
+                        currentLine_.assign(*prevCommand_);
                         if (prevCommand_ == history_.begin()) {
                             onFirstCmd_ = true;
                         } else {
@@ -96,6 +500,7 @@ namespace hh::shell {
                     break;
                 case 'B':
                     // down
+                    restore_history();
                     {
                         auto it = prevCommand_;
                         ++it;
@@ -103,10 +508,7 @@ namespace hh::shell {
                             ++it;
                         }
                         if (it != history_.end()) {
-                            currentLine_.clear();
-                            currentLine_.append(it->data());
-                            lout << ansi::clear_line << prompt_char_;
-                            lout << it->data();
+                            currentLine_.assign(*it);
                             prevCommand_ = it;
                         }
                     }
@@ -114,13 +516,22 @@ namespace hh::shell {
                     break;
                 case 'C':
                     // right
-                    cursor_ += code.params[0];
-                    lout << "\x1b[" << code.params[0] << 'C';
+                    currentLine_.move_cursor(std::max<int>(code.params[0], 1));
                     break;
                 case 'D':
-                    cursor_ -= code.params[0];
-                    lout << "\x1b[" << code.params[0] << 'D';
                     // left
+                    currentLine_.move_cursor(-std::max<int>(code.params[0], 1));
+                    break;
+                case 'b':
+                    set_batch_mode(true);
+                    break;
+                case '~':
+                    // Params too large for a byte are held at 255, so they never start a paste
+                    if (code.params[0] == paste_start_) {
+                        pasting_ = true;
+                    } else if (code.params[0] == paste_end_) {
+                        pasting_ = false;
+                    }
                     break;
                 default:
                     break;
@@ -128,6 +539,17 @@ namespace hh::shell {
         }
 
         void parse_text_char(char ch) {
+            // Only line ends and the end of paste marker are handled in pasted text. Tabs become spaces and other
+            // control chars are dropped, as the terminal would not show them where they are in the line.
+            if (pasting_ && ch != '\x1b' && ch != '\n' && ch != '\r') {
+                if (ch == '\t') {
+                    insert_typed(' ');
+                } else if (!is_control(ch)) {
+                    insert_typed(ch);
+                }
+                return;
+            }
+            if (searching_ && parse_search_char(ch)) { return; }
             switch (ch) {
                 case '\x1b':
                     state_ = parser_state::ansi_cmd;
@@ -135,43 +557,773 @@ namespace hh::shell {
                     break;
                 case '\n':
                 case '\r':
-                    lout << endl
-                         << prompt_char_;
-                    history_.push_back(currentLine_.c_str());
+                    render_line();
+                    lout << endl;
+                    if (!expand_history()) {
+                        new_prompt();
+                        break;
+                    }
+                    add_to_history(currentLine_.view());
                     prevCommand_ = history_.end();
                     --prevCommand_;
-                    currentLine_.clear();
-                    cursor_ = currentLine_.begin();
-                    // todo: run command from command table
+                    run_command();
+                    if (!pipeline_.running()) { new_prompt(); }
+                    break;
+                case ctrl_c_:
+                    render_line();
+                    lout << "^C" << endl;
+                    new_prompt();
                     break;
                 case '\b':
-                    if (!currentLine_.empty()) {
-                        currentLine_.erase(--cursor_);
-                        lout << ansi::save_cursor << ansi::clear_line << prompt_char_ << currentLine_.c_str();
-                        lout << ansi::restore_cursor << ansi::move_left<1>;
+                    currentLine_.erase_before();
+                    break;
+                case '\t':
+                    complete_word();
+                    break;
+                case ctrl_r_:
+                    if constexpr (Config::history_search) {
+                        restore_history();
+                        searching_ = true;
+                        searchLen_ = 0;
+                        restart_search();
+                    }
+                    break;
+                default:
+                    insert_typed(ch);
+                    break;
+            }
+        }
+
+        /// \brief Rebuilds the history from the log the first time it is used
+        void restore_history() {
+            if constexpr (persistent_) {
+                if (historyLog_ == nullptr || historyRestored_) { return; }
+                historyRestored_ = true;
+                historyLog_->replay([this](std::string_view line) { history_.push_back(line); });
+                prevCommand_ = history_.end();
+                if (!history_.empty()) { --prevCommand_; }
+            }
+        }
+
+        void add_to_history(std::string_view line) {
+            restore_history();
+            bool added = history_.push_back(line);
+            if constexpr (persistent_) {
+                if (added && historyLog_ != nullptr) { historyLog_->append(line); }
+            }
+        }
+
+        /// \brief Replaces a reference to a history line at the start of the line with the line it refers to
+        /// \return false if no line matches the reference
+        bool expand_history() {
+            if constexpr (Config::history_expansion) {
+                const auto text = currentLine_.view();
+                const auto end = std::min(text.find_first_of(" \t"), text.size());
+                if (text.empty() || text[0] != '!' || end == 1) { return true; }
+
+                restore_history();
+                const auto event = text.substr(1, end - 1);
+                const auto match = find_event(event);
+                if (match == history_.end()) {
+                    lout << '!' << event << ": event not found" << endl;
+                    return false;
+                }
+                // The reference is replaced in place, in front of the rest of the line
+                currentLine_.set_cursor(end);
+                currentLine_.erase_before(end);
+                currentLine_.insert(match->data(), match->size());
+                currentLine_.set_cursor(currentLine_.size());
+                lout << currentLine_.view() << endl;
+            }
+            return true;
+        }
+
+        /// \brief Finds the line a history reference refers to
+        ///
+        /// Lines are found by their number without a search, `!-n` counts back from the number of the next line.
+        cmd_iter_type find_event(std::string_view event) const {
+            if (history_.empty()) { return history_.end(); }
+            if (event == "!") { return --history_.end(); }
+
+            const bool fromNewest = event[0] == '-';
+            const auto digits = event.substr(fromNewest ? 1 : 0);
+            std::size_t n = 0;
+            bool number = !digits.empty();
+            for (char ch : digits) {
+                number = number && std::isdigit(static_cast<unsigned char>(ch));
+                // Numbers past the end of the history stay past it without overflowing
+                n = std::min(n * 10 + static_cast<std::size_t>(ch - '0'), history_.end().number());
+            }
+            if (number && fromNewest) {
+                if (n == 0 || n > static_cast<std::size_t>(history_.end() - history_.begin())) {
+                    return history_.end();
+                }
+                return history_.find_number((history_.end() - static_cast<std::ptrdiff_t>(n)).number());
+            }
+            if (number) { return history_.find_number(n); }
+            for (auto it = history_.end(); it != history_.begin();) {
+                if ((*--it).starts_with(event)) { return it; }
+            }
+            return history_.end();
+        }
+
+        /// \brief Edits the query of a reverse history search
+        ///
+        /// Any other key accepts the match into the line, and is then handled as usual.
+        /// \return false if the char ended the search and still has to be handled
+        bool parse_search_char(char ch) {
+            switch (ch) {
+                case ctrl_r_:
+                    search_older();
+                    return true;
+                case ctrl_c_:
+                    // The line being typed before the search is shown again
+                    searching_ = false;
+                    return true;
+                case '\b':
+                    if (searchLen_ > 0) {
+                        --searchLen_;
+                        restart_search();
+                    }
+                    return true;
+                default:
+                    if (std::isprint(static_cast<unsigned char>(ch))) {
+                        if (searchLen_ < std::size(searchQuery_)) {
+                            searchQuery_[searchLen_++] = ch;
+                            narrow_search();
+                        }
+                        return true;
+                    }
+                    searching_ = false;
+                    if (searchMatch_ != history_.end()) { currentLine_.assign(*searchMatch_); }
+                    return false;
+            }
+        }
+
+        [[nodiscard]] std::string_view search_query() const { return {searchQuery_, searchLen_}; }
+
+        void find_match(cmd_iter_type from) {
+            auto match = history_.rfind(search_query(), from);
+            // The last match stays shown while the search fails
+            if (match == history_.end()) {
+                searchFailed_ = true;
+            } else {
+                searchMatch_ = match;
+            }
+        }
+
+        /// \brief Searches from the newest line, after the query has been shortened
+        void restart_search() {
+            searchMatch_ = history_.end();
+            searchFailed_ = false;
+            if (searchLen_ > 0 && !history_.empty()) { find_match(--history_.end()); }
+        }
+
+        /// \brief Narrows the search after a char is added to the query
+        ///
+        /// Newer lines than the match did not contain the shorter query, so cannot contain this one, and the
+        /// search carries on from the match instead of rescanning them. A failed search succeeds again if the
+        /// match still shown contains the longer query, as older lines were passed over for the shorter one.
+        void narrow_search() {
+            if (searchMatch_ == history_.end()) {
+                if (!searchFailed_) { restart_search(); }
+            } else if (searchMatch_->find(search_query()) != std::string_view::npos) {
+                searchFailed_ = false;
+            } else if (!searchFailed_) {
+                find_match(searchMatch_);
+            }
+        }
+
+        /// \brief Finds the next older line containing the query
+        void search_older() {
+            if (searchLen_ == 0 || searchFailed_ || searchMatch_ == history_.end()) { return; }
+            if (searchMatch_ == history_.begin()) {
+                searchFailed_ = true;
+                return;
+            }
+            auto from = searchMatch_;
+            find_match(--from);
+        }
+
+        /// \brief The line shown while searching, the query followed by the match
+        struct search_line {
+            std::string_view parts[4];
+
+            [[nodiscard]] std::size_t size() const {
+                std::size_t size = 0;
+                for (auto part : parts) { size += part.size(); }
+                return size;
+            }
+
+            char operator[](std::size_t i) const {
+                for (auto part : parts) {
+                    if (i < part.size()) { return part[i]; }
+                    i -= part.size();
+                }
+                return '\0';
+            }
+        };
+
+        void parse_batch_char(char ch) {
+            // The LF of a CR LF ends the same line as the CR, and the end of a line a command read part of as
+            // its input ends that input rather than a line of its own
+            const bool sameLine = (ch == '\n' && batchCr_) || batchInput_;
+            batchCr_ = ch == '\r';
+            batchInput_ = false;
+            switch (ch) {
+                case '\n':
+                case '\r':
+                    if (sameLine) { break; }
+                    if (batchTooLong_) {
+                        batchTooLong_ = false;
+                        // Lines cut short are not run, reporting the status with the line's tag if it was kept
+                        if (parse_sequence_id(currentLine_.data(), currentLine_.data() + currentLine_.size())) {
+                            lout << "line too long" << endl;
+                            report_status(status_bad_arguments);
+                        }
+                    } else {
+                        run_command();
                     }
+                    if (!pipeline_.running()) { new_prompt(); }
+                    break;
+                case ctrl_d_:
+                    set_batch_mode(false);
                     break;
                 default:
+                    if (!currentLine_.insert(ch)) { batchTooLong_ = true; }
+                    break;
+            }
+        }
+
+        /// \brief Inserts the missing end of the command name or keyword before the cursor
+        ///
+        /// Only the completed chars are added to the line, so rendering it only sends those chars.
+        void complete_word() {
+            auto line = currentLine_.view().substr(0, currentLine_.cursor());
+            auto wordStart = line.find_last_of(' ') + 1;
+            auto word = line.substr(wordStart);
+            auto before = line.substr(0, wordStart);
+            auto cmdStart = before.find_first_not_of(' ');
+
+            // The completion is written straight into the free space at the cursor, which leaves the word and
+            // the chars before it in place
+            auto suffix = currentLine_.gap();
+            completion result{};
+            if (cmdStart == std::string_view::npos) {
+                result = completions_.complete_command(word, suffix.data(), suffix.size());
+            } else {
+                auto name = before.substr(cmdStart, before.find(' ', cmdStart) - cmdStart);
+                if (auto cmd = commands_.find(name); cmd != nullptr) {
+                    result = completions_.complete_keyword(*cmd, word, suffix.data(), suffix.size());
+                }
+            }
+
+            if (!result.found || (result.length == 0 && !result.unique)) {
+                lout << '\a';
+                return;
+            }
+            currentLine_.commit(result.length);
+            counters_.typed(result.length);
+            auto cursor = currentLine_.cursor();
+            if (result.unique && (cursor == currentLine_.size() || currentLine_[cursor] != ' ')) {
+                insert_typed(' ');
+            }
+        }
+
+        /// \brief Brings the line shown on the terminal up to date with the current line
+        void render_line() {
+            // The line holds the arguments of a running command, and is not shown until it is done
+            if (pipeline_.running() || batch_) { return; }
+            if constexpr (tx_ring_) {
+                // Echo lost to a full ring left the terminal out of step with the renderer, the line is drawn
+                // again from the prompt once there is space for it
+                if (lineLost_ && txBuffer_.would_block()) { return; }
+            }
+            auto draw = [this] {
+                if constexpr (tx_ring_) {
+                    if (lineLost_) {
+                        lout << '\r' << ansi::clear_line << prompt_char_;
+                        renderer_.reset();
+                        lineLost_ = false;
+                    }
+                }
+                if (searching_) {
+                    std::string_view match = searchMatch_ == history_.end() ? std::string_view{} : *searchMatch_;
+                    search_line line{{searchFailed_ ? "(failed search)'" : "(search)'", search_query(), "': ", match}};
+                    // The cursor is left at the end of the query
+                    renderer_.render(lout, line, line.parts[0].size() + searchLen_);
+                } else {
+                    renderer_.render(lout, currentLine_, currentLine_.cursor());
+                }
+            };
+            if constexpr (Config::io_counters) {
+                auto before = counters_.tx_bytes;
+                draw();
+                counters_.rendered(counters_.tx_bytes - before);
+            } else {
+                draw();
+            }
+            if constexpr (tx_ring_) {
+                if (txBuffer_.take_overflow()) { lineLost_ = true; }
+            }
+        }
+
+        /// \brief Prints the queued log lines over the prompt, the prompt is redrawn by the next `render_line()`
+        void print_logs() {
+            if (logs_.empty() || pipeline_.running()) { return; }
+            if (!batch_) { lout << '\r' << ansi::clear_line; }
+            while (!logs_.empty()) {
+                auto ch = logs_.pop();
+                if (ch == '\n') {
+                    lout << endl;
+                } else {
                     lout << ch;
-                    currentLine_.insert(cursor_, ch);
-                    ++cursor_;
+                }
+            }
+            if (!batch_) {
+                lout << prompt_char_;
+                renderer_.reset();
+            }
+        }
+
+        static bool is_control(char ch) { return static_cast<unsigned char>(ch) < 0x20 || ch == '\x7f'; }
+
+        /// \brief Turns bracketed paste on or off in the terminal, on while a person is expected to be typing
+        void update_bracketed_paste() {
+            const bool on = pasteWanted_ && !batch_ && !framedHost_;
+            if (on == pasteOn_) { return; }
+            pasteOn_ = on;
+            pasting_ = false;
+            lout << (on ? bracketed_paste_on_ : bracketed_paste_off_);
+        }
+
+        void insert_typed(char ch) {
+            if (currentLine_.insert(ch)) { counters_.typed(1); }
+        }
+
+        void new_prompt() {
+            if (!batch_) { lout << prompt_char_; }
+            renderer_.reset();
+            currentLine_.clear();
+        }
+
+        /// \brief Passes input to the first running command, Ctrl-C cancels every running command
+        void command_input(char ch) {
+            if (ch == ctrl_c_) {
+                pipeline_.cancel();
+                lineQueue_.clear();
+                queuedLineLen_ = 0;
+                tagged_ = false;
+                lout << "^C" << endl;
+                new_prompt();
+            } else if (pipeline_.waiting_for_input()) {
+                batchCr_ = ch == '\r';
+                batchInput_ = ch != '\r' && ch != '\n';
+                pipeline_.input(ch);
+                command_resumed();
+            } else if constexpr (queued_) {
+                queue_input(ch);
+            }
+        }
+
+        /// \brief Queues a char received while a command runs, dropping whole lines once the queue is full
+        ///
+        /// A line cut short would otherwise run joined to the next, under the wrong id. The line that does not
+        /// fit and every char after it are dropped, until the lines queued before it have run and a line has
+        /// ended. The first dropped line's id is then reported with `status_queue_full`, so a host can resend
+        /// from that line on.
+        void queue_input(char ch) {
+            if (!dropping_ && lineQueue_.full()) {
+                dropping_ = true;
+                keepQueued_ = lineQueue_.size() - queuedLineLen_;
+                droppedIdState_ = id_state::start;
+                droppedIdLen_ = 0;
+                for (auto i = keepQueued_; i < lineQueue_.size(); ++i) { read_dropped_char(lineQueue_[i]); }
+            }
+            if (dropping_) {
+                read_dropped_char(ch);
+                return;
+            }
+            lineQueue_.push(ch);
+            queuedLineLen_ = ch == '\r' || ch == '\n' ? 0 : queuedLineLen_ + 1;
+        }
+
+        /// \brief Reads the `#<id>` of the first dropped line, and whether the dropped chars end with a line
+        void read_dropped_char(char ch) {
+            const bool lineEnd = ch == '\r' || ch == '\n';
+            if (droppedIdState_ == id_state::start) {
+                droppedIdState_ = ch == '#' ? id_state::digits : id_state::done;
+                droppedTagged_ = ch == '#';
+            } else if (droppedIdState_ == id_state::digits) {
+                if (ch == ' ' || ch == '\t' || lineEnd) {
+                    droppedIdState_ = id_state::done;
+                } else if (droppedIdLen_ < sizeof(droppedId_)) {
+                    droppedId_[droppedIdLen_++] = ch;
+                } else {
+                    droppedTagged_ = false;
+                }
+            }
+            droppedAtLineEnd_ = lineEnd;
+        }
+
+        /// \brief Drops a char received after a line was dropped, reporting the drop once a line ends
+        void drop_input(char ch) {
+            read_dropped_char(ch);
+            if (keepQueued_ == 0 && !pipeline_.running() && droppedAtLineEnd_) { report_dropped(); }
+        }
+
+        void report_dropped() {
+            dropping_ = false;
+            lineQueue_.clear();
+            queuedLineLen_ = 0;
+            if (!batch_) { lout << '\r' << ansi::clear_line << "input dropped, the line queue is full" << endl; }
+            // Ids that are not numbers are reported without one, as the line would have been
+            tagged_ = droppedTagged_ && arg_parser<std::uint32_t>::parse({droppedId_, droppedIdLen_}, seq_);
+            report_status(status_queue_full);
+            new_prompt();
+        }
+
+        /// \brief Processes the chars received while a command ran, until another command is started
+        ///
+        /// Once a line has been dropped, only the lines queued before it are processed.
+        void run_queued() {
+            if constexpr (queued_) {
+                while (!lineQueue_.empty() && (!pipeline_.running() || pipeline_.waiting_for_input())) {
+                    if (dropping_) {
+                        if (keepQueued_ == 0) { break; }
+                        --keepQueued_;
+                    }
+                    replaying_ = true;
+                    process_rx_char(lineQueue_.pop());
+                    replaying_ = false;
+                }
+                if (dropping_ && keepQueued_ == 0 && !pipeline_.running()) {
+                    // The rest of the dropped line is received and dropped before the drop is reported
+                    lineQueue_.clear();
+                    queuedLineLen_ = 0;
+                    if (droppedAtLineEnd_) { report_dropped(); }
+                }
+            }
+        }
+
+        void command_resumed() {
+            if constexpr (framed_) {
+                if (framedCmd_) {
+                    framed_command_resumed();
+                    return;
+                }
+            }
+            if (!pipeline_.running()) {
+                report_status(pipeline_.result());
+                new_prompt();
+            }
+            run_queued();
+        }
+
+        /// \brief Collects the chars of a frame, handling the frame once its closing delimiter arrives
+        /// \return false if the frame was too long, the char is no longer part of it and still has to be handled
+        bool parse_frame_char(char ch) {
+            if (!inFrame_) {
+                inFrame_ = true;
+                frameSize_ = 0;
+                return true;
+            }
+            if (ch != frame_delimiter) {
+                if (frameSize_ == std::size(frame_)) {
+                    // Too long to be a frame, likely after a stray zero byte, so the chars are text again
+                    inFrame_ = false;
+                    return false;
+                }
+                frame_[frameSize_++] = ch;
+                return true;
+            }
+            // A delimiter straight after another starts the frame again, so hosts can resynchronise
+            if (frameSize_ == 0) { return true; }
+            inFrame_ = false;
+            handle_frame();
+            return true;
+        }
+
+        /// \brief Runs the command requested by a frame, corrupt frames are dropped for the host to resend
+        void handle_frame() {
+            std::size_t size = 0;
+            if (!cobs_decode({frame_, frameSize_}, size) || size > frame_capacity_ || !check_packet({frame_, size})) {
+                return;
+            }
+            framedHost_ = true;
+            update_bracketed_paste();
+            auto seq = static_cast<std::uint8_t>(frame_[0]);
+            std::span<const char> args{frame_ + 1, size - 3};
+
+            if (pipeline_.running()) {
+                frame_response<frame_response_header_size> busy{};
+                busy.start(seq);
+                send_frame(busy.finish(status_busy));
+                return;
+            }
+
+            // Copied, as the next frame may arrive while the command is still using its arguments
+            std::copy(args.begin(), args.end(), request_);
+            response_.start(seq);
+            auto [argc, status] = decode_frame_args({request_, args.size()}, frameArgv_);
+            if (status != frame_args_result::status::ok || argc == 0) {
+                send_frame(response_.finish(status_bad_arguments));
+                return;
+            }
+            auto cmd = commands_.find(frameArgv_[0]);
+            if (cmd == nullptr) {
+                send_frame(response_.finish(status_unknown_command));
+                return;
+            }
+
+            responseOut_.clear();
+            pipeline_stage stage{cmd, {frameArgv_, argc}};
+            if (!pipeline_.start({&stage, 1}, responseOut_)) {
+                send_frame(response_.finish(status_no_free_frames));
+                return;
+            }
+            framedCmd_ = true;
+            framed_command_resumed();
+        }
+
+        /// \brief Commands run from frames have no terminal input, reads return `end_of_input`
+        void framed_command_resumed() {
+            if (pipeline_.waiting_for_input()) { pipeline_.end_input(); }
+            if (!pipeline_.running()) {
+                framedCmd_ = false;
+                send_frame(response_.finish(pipeline_.result()));
+            }
+        }
+
+        void send_frame(std::span<const char> packet) {
+            lout.put(frame_delimiter);
+            cobs_encode(lout, packet);
+            lout.put(frame_delimiter);
+        }
+
+        /// \brief Reports the status of tagged lines, and of every line in batch mode
+        void report_status(int status) {
+            if (tagged_) {
+                lout << '#' << seq_ << '=' << status << endl;
+                tagged_ = false;
+            } else if (batch_) {
+                lout << '=' << status << endl;
+            }
+        }
+
+        /// \brief Reads the `#<id>` a line may start with, reporting an error for ids that are not numbers
+        /// \return The start of the rest of the line, or nullptr if the id is invalid
+        char *parse_sequence_id(char *first, char *last) {
+            tagged_ = false;
+            if (first == last || *first != '#') { return first; }
+            auto tagEnd = std::find_if(first, last, [](char ch) { return ch == ' ' || ch == '\t'; });
+            if (!arg_parser<std::uint32_t>::parse({first + 1, tagEnd}, seq_)) {
+                lout << "invalid sequence id" << endl;
+                report_status(status_bad_arguments);
+                return nullptr;
+            }
+            tagged_ = true;
+            return tagEnd;
+        }
+
+        /// \brief Splits the current line into arguments and runs the matching commands
+        ///
+        /// Commands separated by an unquoted `|` argument are run as a pipeline, each reading the output of the
+        /// one before. Coroutine commands are started and run until they first suspend.
+        /// \note Modifies the current line in place, it must not be changed while a command is running
+        void run_command() {
+            auto line = parse_sequence_id(currentLine_.data(), currentLine_.data() + currentLine_.size());
+            if (line == nullptr) { return; }
+            auto [argc, status] = tokenize(line, currentLine_.data() + currentLine_.size(), argv_, quotedArgs_);
+
+            switch (status) {
+                case tokenize_result::status::too_many_args:
+                    lout << "too many arguments" << endl;
+                    report_status(status_bad_arguments);
+                    return;
+                case tokenize_result::status::unterminated_quote:
+                    lout << "unterminated quote" << endl;
+                    report_status(status_bad_arguments);
+                    return;
+                case tokenize_result::status::ok:
                     break;
             }
+            if (argc == 0) {
+                // Blank lines succeed, and a tag alone lets hosts check that every earlier line has been run
+                report_status(0);
+                return;
+            }
+            if (run_builtin({argv_, argc})) { return; }
+
+            pipeline_stage stages[Config::max_pipeline_stages];
+            std::size_t numStages = 0;
+            std::size_t first = 0;
+            for (std::size_t i = 0; i <= argc; ++i) {
+                if (i < argc && !is_pipe(i)) { continue; }
+                if (i == first || numStages == Config::max_pipeline_stages) {
+                    lout << (i == first ? "empty pipeline stage" : "too many pipeline stages") << endl;
+                    report_status(status_bad_arguments);
+                    return;
+                }
+                auto cmd = commands_.find(argv_[first]);
+                if (cmd == nullptr) {
+                    lout << "unknown command: " << argv_[first] << endl;
+                    report_status(status_unknown_command);
+                    return;
+                }
+                stages[numStages++] = {cmd, {&argv_[first], i - first}};
+                first = i + 1;
+            }
+
+            if (!pipeline_.start({stages, numStages}, cmdOut_)) {
+                lout << "no free command frames" << endl;
+                report_status(status_no_free_frames);
+            } else if (!pipeline_.running()) {
+                report_status(pipeline_.result());
+            }
+        }
+
+        /// \brief Runs commands provided by the shell, unless the command table has a command of the same name
+        /// \return true if the line was a built in command
+        bool run_builtin(command::argv_type argv) {
+            if (!is_builtin(argv[0])) { return false; }
+            // The arguments are the start of argv_
+            for (std::size_t i = 1; i < argv.size(); ++i) {
+                if (is_pipe(i)) {
+                    lout << argv[0] << ": built in commands cannot be piped" << endl;
+                    report_status(status_bad_arguments);
+                    return true;
+                }
+            }
+            if constexpr (Config::io_counters) {
+                if (argv[0] == "iostat") {
+                    if (argv.size() > 1 && argv[1] == "reset") {
+                        counters_.reset();
+                    } else {
+                        print_io_counters(cmdOut_, counters_);
+                    }
+                    report_status(0);
+                    return true;
+                }
+            }
+            if constexpr (Config::history_expansion) {
+                if (argv[0] == "history") {
+                    for (auto it = history_.begin(); it != history_.end(); ++it) {
+                        cmdOut_ << it.number() << "  " << *it << "\n\r";
+                    }
+                    report_status(0);
+                    return true;
+                }
+            }
+            if constexpr (timed_) {
+                if (argv[0] == "stats") {
+                    if (argv.size() > 1 && argv[1] == "reset") {
+                        for (auto &s : stats_) { s.reset(); }
+                    } else {
+                        print_command_stats(cmdOut_, commands_, stats_);
+                    }
+                    report_status(0);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// \brief Checks if an argument separates the stages of a pipeline, a quoted `|` is passed as it is
+        [[nodiscard]] bool is_pipe(std::size_t i) const { return argv_[i] == "|" && !quotedArgs_[i]; }
+
+        [[nodiscard]] bool is_builtin(std::string_view name) const {
+            if (commands_.find(name) != nullptr) { return false; }
+            return (Config::io_counters && name == "iostat") || (Config::history_expansion && name == "history") ||
+                   (timed_ && name == "stats");
         }
 
-        IO &io_;
         static constexpr int_type eof_ = std::char_traits<char>::eof();
+        static constexpr bool timed_ = hh::shell::command_timer<typename Config::command_timer>;
+        static constexpr char ctrl_c_ = '\x03';
+        static constexpr char ctrl_d_ = '\x04';
+        static constexpr char ctrl_r_ = '\x12';
+        static constexpr char xon_ = '\x11';
+        static constexpr char xoff_ = '\x13';
+        static constexpr bool tx_ring_ = Config::tx_ring_size > 0;
+        static_assert(tx_ring_ || !Config::xon_xoff, "XON/XOFF flow control needs a tx_ring_size");
+        static constexpr bool framed_ = Config::frame_size > 0;
+        static constexpr bool queued_ = Config::line_queue_size > 0;
+        static constexpr bool logged_ = Config::log_buffer_size > 0;
+        static constexpr bool persistent_ = block_storage<typename Config::history_storage>;
+        static constexpr const char *bracketed_paste_on_ = "\x1b[?2004h";
+        static constexpr const char *bracketed_paste_off_ = "\x1b[?2004l";
+        static constexpr std::uint8_t paste_start_ = 200;
+        static constexpr std::uint8_t paste_end_ = 201;
         const char prompt_char_{'>'};
         const char *welcome_message_{""};
         const char *endl{"\n\r"};
         history history_;
-        string currentLine_;
+        line_buffer currentLine_;
         cmd_iter_type prevCommand_{history_.begin()};
         bool onFirstCmd_ = false;
-        const char *cursor_{currentLine_.begin()};
+        ansi::line_renderer<LineLen> renderer_{};
         parser_state state_{parser_state::text};
         ansi::parser parser_{};
-        const command *commandTable_{nullptr};
-        std::size_t numCommands_{0};
+        command_set commands_{};
+        completion_set completions_{};
+        output_sink cmdSink_{lout};
+        cmd_ostream cmdOut_{cmdSink_};
+        std::string_view argv_[Config::max_args]{};
+        bool quotedArgs_[Config::max_args]{};
+        pipeline<Config::max_pipeline_stages, Config::pipe_size, typename Config::command_timer> pipeline_{};
+        std::span<command_stats> stats_{};
+        bool batch_{Config::batch_mode};
+        bool pasting_{false};
+        // Set when output was cut short by a full tx ring, so the line has to be drawn again
+        bool lineLost_{false};
+        // Whether the last batch char was a CR or ended part way through a command's input, and whether the
+        // batch line was too long to hold
+        bool batchCr_{false};
+        bool batchInput_{false};
+        bool batchTooLong_{false};
+        // Whether a terminal is connected that should bracket pastes, and whether it was last told to
+        bool pasteWanted_{false};
+        bool pasteOn_{false};
+        // Set once a frame arrives, the frames come from a program rather than a person at a terminal
+        bool framedHost_{false};
+        container::ring_buffer<char, logged_ ? Config::log_buffer_size : 1> logs_{};
+        // Chars read in bulk but held back while a command runs in batch mode
+        char rxChunk_[serial_bulk_in_device<IO> ? Config::rx_chunk_size : 1]{};
+        std::size_t rxPos_{0};
+        std::size_t rxSize_{0};
+        container::ring_buffer<char, queued_ ? Config::line_queue_size : 1> lineQueue_{};
+        // The chars of the last line in the queue that has not ended yet
+        std::size_t queuedLineLen_{0};
+        // Set once a line does not fit in the queue, see `queue_input()`
+        bool dropping_{false};
+        bool replaying_{false};
+        std::size_t keepQueued_{0};
+        bool droppedAtLineEnd_{false};
+        enum class id_state : std::uint8_t { start, digits, done };
+        id_state droppedIdState_{id_state::done};
+        bool droppedTagged_{false};
+        char droppedId_[10]{};
+        std::size_t droppedIdLen_{0};
+        bool searching_{false};
+        bool searchFailed_{false};
+        char searchQuery_[Config::history_search ? LineLen : 1]{};
+        std::size_t searchLen_{0};
+        cmd_iter_type searchMatch_{history_.end()};
+        history_log_type *historyLog_{nullptr};
+        bool historyRestored_{false};
+        bool tagged_{false};
+        std::uint32_t seq_{0};
+        // The binary protocol, sized to a single char when disabled
+        static constexpr std::size_t frame_capacity_ = framed_ ? Config::frame_size : 1;
+        char frame_[framed_ ? cobs_max_encoded_size(frame_capacity_) : 1]{};
+        std::size_t frameSize_{0};
+        bool inFrame_{false};
+        bool framedCmd_{false};
+        char request_[frame_capacity_]{};
+        std::string_view frameArgv_[framed_ ? Config::max_args : 1]{};
+        frame_response<std::max(frame_capacity_, frame_response_header_size)> response_{};
+        output_sink responseSink_{response_};
+        cmd_ostream responseOut_{responseSink_};
     };
 }// namespace hh::shell
\ No newline at end of file
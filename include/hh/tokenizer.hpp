@@ -0,0 +1,38 @@
+/// \file tokenizer.hpp
+/// \brief Splits a command line into arguments in place
+
+#pragma once
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+namespace hh::shell {
+
+    struct tokenize_result {
+        enum class status {
+            ok,
+            too_many_args,
+            unterminated_quote,
+        };
+
+        std::size_t argc{0};
+        status result{status::ok};
+
+        [[nodiscard]] bool good() const { return result == status::ok; }
+    };
+
+    /// \brief Splits a line into whitespace separated arguments, without copying or allocating
+    ///
+    /// Text inside single quotes is taken literally, text inside double quotes may contain `\"` and `\\`,
+    /// and outside of quotes a backslash escapes the next char. Quotes and escapes are removed by
+    /// compacting each argument towards the start of the buffer, so the line is modified in place and
+    /// every argument is a view into it.
+    /// \param first The start of the line
+    /// \param last One past the end of the line
+    /// \param args Receives the arguments
+    /// \param quoted Receives whether each argument contained quotes or escapes, so a quoted `|` can be told
+    /// apart from a pipe, if not empty it must be as long as args
+    /// \return The number of arguments found, and whether the line could be fully tokenized
+    tokenize_result tokenize(char *first, char *last, std::span<std::string_view> args,
+                             std::span<bool> quoted = {});
+}// namespace hh::shell
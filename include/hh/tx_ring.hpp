@@ -0,0 +1,95 @@
+/// \file tx_ring.hpp
+/// \brief Non-blocking output buffering with flow control, for devices that cannot always accept output
+
+#pragma once
+#include <cstddef>
+#include <hh/concepts.hpp>
+#include <hh/lock.hpp>
+#include <hh/ring_buffer.hpp>
+#include <utility>
+
+namespace hh::shell {
+
+    /// \brief Holds output in a ring buffer until a non-blocking device can accept it
+    ///
+    /// Writes never wait for the device. They are copied into the ring, and a write that does not fit is cut
+    /// short, returning the number of chars kept. The ring is drained by `send()` with as few device writes
+    /// as possible, taking only what the device accepts without blocking. Output can be paused, for example
+    /// when the host sends XOFF, and producers should hold off writing while `would_block()` is true.
+    ///
+    /// The chars written between two calls to `send()` are a message. If the ring fills during a message, the
+    /// lock taken to drain it is held until `send()` ends the message, so other writers sharing the device
+    /// and lock do not interleave their output with it.
+    /// \tparam Out The output device type
+    /// \tparam N The size of the ring
+    /// \tparam HighWater The number of buffered chars at which `would_block()` becomes true
+    /// \tparam Lock The locking policy, held by reference while writing to the device
+    template<serial_nonblocking_out_device Out, std::size_t N, std::size_t HighWater = N * 3 / 4,
+             basic_lockable Lock = null_lock>
+    class tx_ring {
+    public:
+        static_assert(HighWater > 0 && HighWater <= N, "the high water mark must be within the ring");
+
+        explicit tx_ring(Out &out, Lock &lock = default_lock<Lock>)
+            : out_{&out}, lock_{&lock} {}
+
+        /// \brief Copies as many chars as fit into the ring, sending buffered output first if the ring is full
+        /// \return The number of chars kept, less than count if the ring filled
+        std::size_t write(const char *s, std::size_t count) {
+            if (ring_.capacity() - ring_.size() < count) { drain(); }
+            auto n = ring_.push(std::span<const char>{s, count});
+            if (n < count) { overflowed_ = true; }
+            return n;
+        }
+
+        /// \brief Checks if a write has been cut short since the last call, so some output was lost
+        [[nodiscard]] bool take_overflow() { return std::exchange(overflowed_, false); }
+
+        /// \brief Writes buffered chars to the device until it stops accepting them, unless paused, ending the
+        /// message
+        void send() {
+            drain();
+            if (held_) {
+                held_ = false;
+                lock_->unlock();
+            }
+        }
+
+        /// \brief Sends what the device accepts, never waits for the ring to drain
+        void flush() { send(); }
+
+        /// \brief Stops writing to the device until `resume()` is called, output is still buffered
+        void pause() { paused_ = true; }
+        void resume() { paused_ = false; }
+        [[nodiscard]] bool paused() const { return paused_; }
+
+        /// \brief Checks if output is paused, or the ring has filled to the high water mark
+        [[nodiscard]] bool would_block() const { return paused_ || ring_.size() >= HighWater; }
+
+        [[nodiscard]] bool empty() const { return ring_.empty(); }
+        [[nodiscard]] std::size_t size() const { return ring_.size(); }
+        [[nodiscard]] static constexpr std::size_t capacity() { return N; }
+
+    private:
+        Out *out_;
+        Lock *lock_;
+        container::ring_buffer<char, N> ring_{};
+        bool paused_{false};
+        bool held_{false};
+        bool overflowed_{false};
+
+        void drain() {
+            if (paused_ || ring_.empty()) { return; }
+            if (!held_) {
+                lock_->lock();
+                held_ = true;
+            }
+            while (!ring_.empty()) {
+                auto segment = ring_.front_segment();
+                auto n = out_->try_write(segment.data(), segment.size());
+                ring_.consume(n);
+                if (n < segment.size()) { break; }
+            }
+        }
+    };
+}// namespace hh::shell
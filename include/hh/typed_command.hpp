@@ -0,0 +1,201 @@
+/// \file typed_command.hpp
+/// \brief Commands with typed parameters, parsed from their arguments by generated code
+
+#pragma once
+#include <concepts>
+#include <cstdint>
+#include <hh/command_table.hpp>
+#include <iterator>
+#include <limits>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace hh::shell {
+
+    /// \brief An integer argument limited to a range, inclusive of both ends
+    template<auto Min, decltype(Min) Max>
+    struct in_range {
+        using value_type = decltype(Min);
+        static_assert(std::integral<value_type> && Min <= Max);
+
+        value_type value{Min};
+
+        constexpr operator value_type() const { return value; }
+    };
+
+    /// \brief Names the values of an enum, specialize it to use the enum as a typed command parameter
+    ///
+    /// Specializations have a `values` array of name and value pairs, for example
+    /// `static constexpr std::pair<std::string_view, color> values[] = {{"red", color::red}};`
+    template<class Enum>
+    struct enum_names;
+
+    template<class T>
+    concept named_enum = std::is_enum_v<T> && requires { std::size(enum_names<T>::values); };
+
+    /// \brief Converts an argument to a parameter type, specialize it to support other types
+    template<class T>
+    struct arg_parser;
+
+    template<>
+    struct arg_parser<std::string_view> {
+        static constexpr bool parse(std::string_view arg, std::string_view &value) {
+            value = arg;
+            return true;
+        }
+    };
+
+    template<>
+    struct arg_parser<bool> {
+        static constexpr bool parse(std::string_view arg, bool &value) {
+            if (arg == "1" || arg == "on" || arg == "true") {
+                value = true;
+            } else if (arg == "0" || arg == "off" || arg == "false") {
+                value = false;
+            } else {
+                return false;
+            }
+            return true;
+        }
+    };
+
+    /// \brief Parses decimal, or hex with a 0x prefix, integers, failing if the value does not fit the type
+    template<std::integral T>
+    requires(!std::same_as<T, bool>) struct arg_parser<T> {
+        static constexpr bool parse(std::string_view arg, T &value) {
+            return parse_range(arg, value, std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
+        }
+
+        static constexpr bool parse_range(std::string_view arg, T &value, T min, T max) {
+            bool negative = std::signed_integral<T> && !arg.empty() && arg.front() == '-';
+            if (negative) { arg.remove_prefix(1); }
+            unsigned base = 10;
+            if (arg.size() > 2 && arg[0] == '0' && (arg[1] == 'x' || arg[1] == 'X')) {
+                base = 16;
+                arg.remove_prefix(2);
+            }
+            if (arg.empty()) { return false; }
+
+            // Accumulated as a magnitude, so the most negative value can be parsed
+            using magnitude = std::make_unsigned_t<T>;
+            magnitude limit = negative ? magnitude(-(min + 1)) + 1u : magnitude(max);
+            magnitude n = 0;
+            for (char ch : arg) {
+                auto digit = digit_value(ch);
+                if (digit >= base || digit > limit || n > (limit - digit) / base) { return false; }
+                n = static_cast<magnitude>(n * base + digit);
+            }
+            T result = negative ? static_cast<T>(-static_cast<T>(n - 1) - 1) : static_cast<T>(n);
+            if (result < min || result > max) { return false; }
+            value = result;
+            return true;
+        }
+
+    private:
+        static constexpr unsigned digit_value(char ch) {
+            if (ch >= '0' && ch <= '9') { return static_cast<unsigned>(ch - '0'); }
+            if (ch >= 'a' && ch <= 'f') { return static_cast<unsigned>(ch - 'a' + 10); }
+            if (ch >= 'A' && ch <= 'F') { return static_cast<unsigned>(ch - 'A' + 10); }
+            return 16;
+        }
+    };
+
+    template<auto Min, decltype(Min) Max>
+    struct arg_parser<in_range<Min, Max>> {
+        static constexpr bool parse(std::string_view arg, in_range<Min, Max> &value) {
+            using T = decltype(Min);
+            return arg_parser<T>::parse_range(arg, value.value, Min, Max);
+        }
+    };
+
+    template<named_enum Enum>
+    struct arg_parser<Enum> {
+        static constexpr bool parse(std::string_view arg, Enum &value) {
+            for (const auto &[name, v] : enum_names<Enum>::values) {
+                if (name == arg) {
+                    value = v;
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    template<class T>
+    concept parsable_arg = std::default_initializable<T> && requires(std::string_view arg, T &value) {
+        { arg_parser<T>::parse(arg, value) } -> std::convertible_to<bool>;
+    };
+
+    namespace detail {
+        template<class Fn>
+        struct typed_signature;
+
+        /// \brief Functions may take the command's output stream as their last parameter
+        template<class... Params>
+        struct typed_signature<int (*)(Params...)> {
+            static constexpr bool takes_out = [] {
+                if constexpr (sizeof...(Params) == 0) {
+                    return false;
+                } else {
+                    return std::same_as<std::tuple_element_t<sizeof...(Params) - 1, std::tuple<Params...>>,
+                                        cmd_ostream &>;
+                }
+            }();
+            static constexpr std::size_t num_args = sizeof...(Params) - takes_out;
+
+            template<std::size_t I>
+            using arg_type = std::remove_cvref_t<std::tuple_element_t<I, std::tuple<Params...>>>;
+        };
+
+        template<class... Params>
+        struct typed_signature<int (*)(Params...) noexcept> : typed_signature<int (*)(Params...)> {};
+
+        template<auto Fn, std::size_t... I>
+        int invoke_typed(command::argv_type argv, cmd_ostream &out, std::index_sequence<I...>) {
+            using signature = typed_signature<decltype(Fn)>;
+            static_assert((parsable_arg<typename signature::template arg_type<I>> && ...),
+                          "typed command parameters need an arg_parser");
+
+            if (argv.size() != signature::num_args + 1) {
+                out << "expected " << signature::num_args << " arguments\n\r";
+                return status_bad_arguments;
+            }
+
+            std::tuple<typename signature::template arg_type<I>...> args{};
+            std::size_t bad = 0;
+            [[maybe_unused]] auto parse = [&]<std::size_t N>(std::integral_constant<std::size_t, N>) {
+                using T = typename signature::template arg_type<N>;
+                if (arg_parser<T>::parse(argv[N + 1], std::get<N>(args))) { return true; }
+                bad = N + 1;
+                return false;
+            };
+            // Stops at the first argument that cannot be parsed
+            bool parsed = (parse(std::integral_constant<std::size_t, I>{}) && ...);
+            if (!parsed) {
+                out << "invalid argument: " << argv[bad] << "\n\r";
+                return status_bad_arguments;
+            }
+
+            if constexpr (signature::takes_out) {
+                return Fn(std::get<I>(args)..., out);
+            } else {
+                return Fn(std::get<I>(args)...);
+            }
+        }
+    }// namespace detail
+
+    /// \brief Adapts a function with typed parameters to a command function
+    ///
+    /// The parser for each parameter is chosen at compile time, so no type information is kept at runtime.
+    /// The argument count is checked, and each argument parsed with `arg_parser`. On failure a message is
+    /// written and `status_bad_arguments` returned, without calling the function.
+    /// \tparam Fn A function returning int, whose parameters are integers, `in_range`, `bool`, named enums,
+    /// `std::string_view`, or types with an `arg_parser`, optionally followed by `cmd_ostream &`
+    template<auto Fn>
+    int typed_command(command::argv_type argv, cmd_ostream &out) {
+        using signature = detail::typed_signature<decltype(Fn)>;
+        return detail::invoke_typed<Fn>(argv, out, std::make_index_sequence<signature::num_args>{});
+    }
+}// namespace hh::shell
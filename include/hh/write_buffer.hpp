@@ -0,0 +1,95 @@
+/// \file write_buffer.hpp
+/// \brief Coalesces small writes to a serial output device
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <hh/concepts.hpp>
+#include <hh/lock.hpp>
+
+namespace hh::shell {
+
+    /// \brief Collects writes in a fixed size staging buffer and passes them on to a device as a single write
+    ///
+    /// Buffered chars are written to the device when the buffer fills, or when `send()` or `flush()` is called.
+    /// The chars written between two sends are a message. The lock is taken by the first write of a message
+    /// to the device and held until the message is sent, so a message larger than the buffer is never
+    /// interleaved with output from other writers sharing the device and lock.
+    /// \tparam Out The output device type
+    /// \tparam N The size of the staging buffer
+    /// \tparam Lock The locking policy, held by reference
+    template<serial_out_device Out, std::size_t N, basic_lockable Lock = null_lock>
+    class write_buffer {
+    public:
+        static_assert(N > 0, "write buffers need space for at least one char");
+
+        explicit write_buffer(Out &out, Lock &lock = default_lock<Lock>)
+            : out_{&out}, lock_{&lock} {}
+
+        /// \brief Appends chars to the buffer, writing the buffer to the device each time it fills
+        /// \param s The chars to write
+        /// \param count The number of chars to write
+        void write(const char *s, std::size_t count) {
+            if (size_ == 0 && count >= N) {
+                // Nothing to coalesce with, pass large writes straight through
+                acquire();
+                out_->write(s, count);
+                return;
+            }
+
+            while (count > 0) {
+                if (size_ == N) { write_buffered(); }
+                auto n = std::min(count, N - size_);
+                std::copy_n(s, n, &buffer_[size_]);
+                size_ += n;
+                s += n;
+                count -= n;
+            }
+        }
+
+        /// \brief Writes all buffered chars to the device with a single write, ending the message
+        /// \post `empty()` returns true, and the lock is not held
+        void send() {
+            write_buffered();
+            release();
+        }
+
+        /// \brief Writes all buffered chars to the device and flushes it, ending the message
+        void flush() {
+            write_buffered();
+            acquire();
+            out_->flush();
+            release();
+        }
+
+        [[nodiscard]] bool empty() const { return size_ == 0; }
+        [[nodiscard]] std::size_t size() const { return size_; }
+        [[nodiscard]] static constexpr std::size_t capacity() { return N; }
+
+    private:
+        Out *out_;
+        Lock *lock_;
+        char buffer_[N]{};
+        std::size_t size_{0};
+        bool held_{false};
+
+        void write_buffered() {
+            if (size_ == 0) { return; }
+            acquire();
+            out_->write(buffer_, size_);
+            size_ = 0;
+        }
+
+        void acquire() {
+            if (held_) { return; }
+            lock_->lock();
+            held_ = true;
+        }
+
+        void release() {
+            if (!held_) { return; }
+            held_ = false;
+            lock_->unlock();
+        }
+    };
+}// namespace hh::shell
@@ -1,6 +1,7 @@
 /// \file ansi_parser.cpp
 /// \brief Created on 2021-08-30 by Ben
 
+#include <algorithm>
 #include <hh/ansi_parser.hpp>
 
 hh::ansi::parser::parser(const char *s, std::size_t count) {
@@ -34,8 +35,8 @@ void hh::ansi::parser::update_state(char ch) {
         case state::digit_terminator_sep:
             if (std::isdigit(ch)) {
                 auto &p = code_.params[code_.num_params];
-                p *= 10;
-                p += ch - '0';
+                // Params too large for a byte are held at 255, rather than wrapping round to a valid code
+                p = static_cast<std::uint8_t>(std::min(p * 10 + (ch - '0'), 0xff));
                 return;
             } else if (ch == ';') {
                 ++code_.num_params;
@@ -67,7 +68,8 @@ bool hh::ansi::parser::parse(char ch) {
 }
 
 bool hh::ansi::parser::is_terminator(char ch) {
-    return std::isalpha(ch);
+    // '~' ends VT style key codes, and the bracketed paste markers
+    return std::isalpha(ch) || ch == '~';
 }
 void hh::ansi::parser::reset() {
     status_ = true;
@@ -0,0 +1,16 @@
+/// \file command_stats.cpp
+/// \brief Printing of command run time statistics
+
+#include <hh/command_stats.hpp>
+
+void hh::shell::print_command_stats(cmd_ostream &out, command_set commands, std::span<const command_stats> stats) {
+    out << "command calls max histogram\n\r";
+    for (std::size_t i = 0; i < stats.size() && i < commands.size(); ++i) {
+        const auto &s = stats[i];
+        const std::uint32_t calls = s.calls;
+        if (calls == 0) { continue; }
+        out << commands.begin()[i].cmd_name << ' ' << calls << ' ' << std::uint32_t{s.max_ticks};
+        for (const std::uint16_t count : s.buckets) { out << ' ' << count; }
+        out << "\n\r";
+    }
+}
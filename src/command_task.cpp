@@ -0,0 +1,70 @@
+/// \file command_task.cpp
+/// \brief Fixed pools of coroutine frames for command tasks
+
+#include <hh/command_task.hpp>
+#include <hh/hal_assert.hpp>
+
+namespace {
+    hh::shell::static_frame_pool<hh::shell::default_command_frame_size, hh::shell::default_max_command_frames>
+            defaultPool{};
+    hh::shell::frame_pool *attachedPool{&defaultPool};
+    hh::shell::lock_ref poolLock{};
+    // The number of shells that have attached the pool and not detached it yet
+    std::size_t numAttached{0};
+}// namespace
+
+bool hh::shell::frame_pool::in_use() const {
+    for (bool used : used_) {
+        if (used) { return true; }
+    }
+    return false;
+}
+
+void *hh::shell::frame_pool::allocate(std::size_t size) noexcept {
+    if (size > frameSize_) { return nullptr; }
+    for (std::size_t i = 0; i < used_.size(); ++i) {
+        if (!used_[i]) {
+            used_[i] = true;
+            return frames_ + i * frameSize_;
+        }
+    }
+    return nullptr;
+}
+
+void hh::shell::frame_pool::deallocate(void *frame) noexcept {
+    for (std::size_t i = 0; i < used_.size(); ++i) {
+        if (frame == frames_ + i * frameSize_) {
+            used_[i] = false;
+            return;
+        }
+    }
+}
+
+hh::shell::frame_pool &hh::shell::default_frame_pool() { return defaultPool; }
+
+void hh::shell::attach_frame_pool(frame_pool &pool, lock_ref lock) {
+    if (numAttached == 0) {
+        // Frames still in use are returned to the pool they came from
+        assert(&pool == attachedPool || !attachedPool->in_use());
+        attachedPool = &pool;
+        poolLock = lock;
+    }
+    assert(&pool == attachedPool && lock == poolLock);
+    ++numAttached;
+}
+
+void hh::shell::detach_frame_pool() {
+    // The pool stays attached, the frames of the detaching shell's commands are freed after it detaches. The
+    // lock may be destroyed with the last shell, and no other shell is left to hold it against.
+    if (numAttached > 0 && --numAttached == 0) { poolLock = {}; }
+}
+
+void *hh::shell::command_task::promise_type::operator new(std::size_t size) noexcept {
+    lock_guard guard{poolLock};
+    return attachedPool->allocate(size);
+}
+
+void hh::shell::command_task::promise_type::operator delete(void *frame) noexcept {
+    lock_guard guard{poolLock};
+    attachedPool->deallocate(frame);
+}
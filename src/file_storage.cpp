@@ -0,0 +1,43 @@
+/// \file file_storage.cpp
+/// \brief Block storage kept in a file, for the history log of host builds and tests
+
+#include <algorithm>
+#include <hh/file_storage.hpp>
+#include <iterator>
+
+hh::shell::file_storage::file_storage(const char *path, std::size_t pageSize, std::size_t pageCount)
+    : file_{std::fopen(path, "r+b")}, pageSize_{pageSize}, pageCount_{pageCount} {
+    if (file_ == nullptr) { file_ = std::fopen(path, "w+b"); }
+}
+
+hh::shell::file_storage::~file_storage() {
+    if (file_ != nullptr) { std::fclose(file_); }
+}
+
+void hh::shell::file_storage::read(std::size_t page, std::size_t offset, std::span<char> out) {
+    std::size_t count = 0;
+    if (file_ != nullptr && std::fseek(file_, static_cast<long>(page * pageSize_ + offset), SEEK_SET) == 0) {
+        count = std::fread(out.data(), 1, out.size(), file_);
+    }
+    std::fill(out.begin() + static_cast<std::ptrdiff_t>(count), out.end(), '\xff');
+}
+
+void hh::shell::file_storage::program(std::size_t page, std::size_t offset, std::span<const char> in) {
+    if (file_ == nullptr || std::fseek(file_, static_cast<long>(page * pageSize_ + offset), SEEK_SET) != 0) {
+        return;
+    }
+    std::fwrite(in.data(), 1, in.size(), file_);
+    std::fflush(file_);
+}
+
+void hh::shell::file_storage::erase(std::size_t page) {
+    if (file_ == nullptr || std::fseek(file_, static_cast<long>(page * pageSize_), SEEK_SET) != 0) { return; }
+    char erased[64];
+    std::fill(std::begin(erased), std::end(erased), '\xff');
+    for (std::size_t left = pageSize_; left > 0;) {
+        auto n = std::min(left, sizeof(erased));
+        std::fwrite(erased, 1, n, file_);
+        left -= n;
+    }
+    std::fflush(file_);
+}
@@ -0,0 +1,57 @@
+/// \file framing.cpp
+/// \brief COBS framed packets with a CRC, for the shell's binary protocol
+
+#include <hh/framing.hpp>
+
+bool hh::shell::cobs_decode(std::span<char> frame, std::size_t &size) {
+    std::size_t read = 0;
+    std::size_t write = 0;
+    while (read < frame.size()) {
+        auto code = static_cast<std::uint8_t>(frame[read++]);
+        if (code == 0 || code - 1u > frame.size() - read) { return false; }
+        // The code byte has been consumed, so writing behind the read position is safe
+        for (std::size_t i = 1; i < code; ++i) { frame[write++] = frame[read++]; }
+        if (code != 0xff && read != frame.size()) { frame[write++] = '\0'; }
+    }
+    size = write;
+    return true;
+}
+
+std::uint16_t hh::shell::crc16(std::span<const char> data, std::uint16_t crc) {
+    for (char ch : data) {
+        crc ^= static_cast<std::uint16_t>(static_cast<std::uint8_t>(ch) << 8);
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = static_cast<std::uint16_t>(crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1);
+        }
+    }
+    return crc;
+}
+
+bool hh::shell::check_packet(std::span<const char> packet) {
+    if (packet.size() < 3) { return false; }
+    auto body = packet.first(packet.size() - 2);
+    auto stored = static_cast<std::uint16_t>(static_cast<std::uint8_t>(packet[packet.size() - 2]) |
+                                             static_cast<std::uint8_t>(packet[packet.size() - 1]) << 8);
+    return crc16(body) == stored;
+}
+
+hh::shell::frame_args_result hh::shell::decode_frame_args(std::span<const char> data,
+                                                          std::span<std::string_view> args) {
+    using status = frame_args_result::status;
+    frame_args_result result{};
+    std::size_t pos = 0;
+    while (pos < data.size()) {
+        if (result.argc == args.size()) {
+            result.result = status::too_many_args;
+            break;
+        }
+        auto length = static_cast<std::uint8_t>(data[pos++]);
+        if (length > data.size() - pos) {
+            result.result = status::truncated;
+            break;
+        }
+        args[result.argc++] = {data.data() + pos, length};
+        pos += length;
+    }
+    return result;
+}
@@ -0,0 +1,14 @@
+/// \file io_counters.cpp
+/// \brief Printing of shell input and output counters
+
+#include <hh/io_counters.hpp>
+
+void hh::shell::print_io_counters(cmd_ostream &out, const io_counters &counters) {
+    out << "rx " << counters.rx_bytes << "\n\r"
+        << "tx " << counters.tx_bytes << "\n\r"
+        << "max rx burst " << counters.max_rx_burst << "\n\r"
+        << "ansi parsed " << counters.ansi_parsed << "\n\r"
+        << "ansi rejected " << counters.ansi_rejected << "\n\r"
+        << "echo " << counters.echo_bytes << "\n\r"
+        << "redraw " << counters.redraw_bytes << "\n\r";
+}
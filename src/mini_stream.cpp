@@ -2,3 +2,17 @@
 /// \brief Created on 2021-08-30 by Ben
 
 #include <hh/mini_stream.hpp>
+
+namespace hh::shell {
+
+    bool mini_basic_ios::good() const { return state_ == goodbit; }
+    bool mini_basic_ios::eof() const { return (state_ & eofbit) != 0; }
+    bool mini_basic_ios::fail() const { return (state_ & (failbit | badbit)) != 0; }
+    bool mini_basic_ios::bad() const { return (state_ & badbit) != 0; }
+    bool mini_basic_ios::operator!() const { return fail(); }
+    mini_basic_ios::operator bool() const { return !fail(); }
+
+    mini_basic_ios::iostate mini_basic_ios::rdstate() const { return state_; }
+    void mini_basic_ios::setstate(iostate state) { state_ |= state; }
+    void mini_basic_ios::clear(iostate state) { state_ = state; }
+}// namespace hh::shell
@@ -0,0 +1,69 @@
+/// \file tokenizer.cpp
+/// \brief Splits a command line into arguments in place
+
+#include <hh/tokenizer.hpp>
+
+namespace {
+    bool is_separator(char ch) { return ch == ' ' || ch == '\t'; }
+}// namespace
+
+hh::shell::tokenize_result hh::shell::tokenize(char *first, char *last, std::span<std::string_view> args,
+                                               std::span<bool> quoted) {
+    using status = tokenize_result::status;
+    tokenize_result result{};
+    char *read = first;
+
+    while (true) {
+        while (read != last && is_separator(*read)) { ++read; }
+        if (read == last) { break; }
+
+        if (result.argc == args.size()) {
+            result.result = status::too_many_args;
+            break;
+        }
+
+        // Arguments only ever shrink, so writing behind the read position is safe
+        char *const start = read;
+        char *write = read;
+        char quote = 0;
+        bool literal = false;
+
+        while (read != last) {
+            char ch = *read++;
+            if (quote == '\'') {
+                if (ch == '\'') {
+                    quote = 0;
+                } else {
+                    *write++ = ch;
+                }
+            } else if (quote == '"') {
+                if (ch == '"') {
+                    quote = 0;
+                } else if (ch == '\\' && read != last && (*read == '"' || *read == '\\')) {
+                    *write++ = *read++;
+                } else {
+                    *write++ = ch;
+                }
+            } else if (is_separator(ch)) {
+                break;
+            } else if (ch == '\'' || ch == '"') {
+                quote = ch;
+                literal = true;
+            } else if (ch == '\\' && read != last) {
+                *write++ = *read++;
+                literal = true;
+            } else {
+                *write++ = ch;
+            }
+        }
+
+        if (quote != 0) {
+            result.result = status::unterminated_quote;
+            break;
+        }
+        if (!quoted.empty()) { quoted[result.argc] = literal; }
+        args[result.argc++] = std::string_view{start, static_cast<std::size_t>(write - start)};
+    }
+
+    return result;
+}
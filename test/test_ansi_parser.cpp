@@ -13,7 +13,11 @@ TEST_CASE("ansi parser", "[ansi]") {
             std::tuple{std::string{"[H"}, parser::ansi_code{0, {0, 0, 0}, 'H'}},
             std::tuple{std::string{"[5A"}, parser::ansi_code{1, {5, 0, 0}, 'A'}},
             std::tuple{std::string{"[38;5m"}, parser::ansi_code{2, {38, 5, 0}, 'm'}},
-            std::tuple{std::string{"[38;7;5m"}, parser::ansi_code{3, {38, 7, 5}, 'm'}});
+            std::tuple{std::string{"[38;7;5m"}, parser::ansi_code{3, {38, 7, 5}, 'm'}},
+            std::tuple{std::string{"[200~"}, parser::ansi_code{1, {200, 0, 0}, '~'}},
+            std::tuple{std::string{"[201~"}, parser::ansi_code{1, {201, 0, 0}, '~'}},
+            std::tuple{std::string{"[456~"}, parser::ansi_code{1, {255, 0, 0}, '~'}},
+            std::tuple{std::string{"[5;2000A"}, parser::ansi_code{2, {5, 255, 0}, 'A'}});
 
     CAPTURE(str);
     parser p{str.c_str(), str.size()};
@@ -3,8 +3,10 @@
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/generators/catch_generators.hpp>
+#include <chrono>
 #include <hh/cmd_history.hpp>
 #include <string>
+#include <vector>
 
 using namespace std::string_literals;
 
@@ -33,7 +35,8 @@ SCENARIO("multiple lines can be stored, accessed and iterated over") {
     }
 
     GIVEN("a full history") {
-        hh::shell::cmd_history<4, 4> history;
+        // Each line takes its length and a mask of its chars as well, so the RAM of 9 lines of 4 chars holds 4
+        hh::shell::cmd_history<9, 4> history;
         int offset = GENERATE(0, 1, 2, 3, 4);
         CAPTURE(offset);
 
@@ -46,7 +49,7 @@ SCENARIO("multiple lines can be stored, accessed and iterated over") {
         std::vector<std::string> cmds{"cmd1", "cmd2", "cmd3", "cmd4"};
         for (const auto &s : cmds) { history.push_back(s.c_str()); }
         std::vector<std::string> foundCmds{};
-        for (auto cmd : history) { foundCmds.emplace_back(cmd.data()); }
+        for (auto cmd : history) { foundCmds.emplace_back(cmd); }
 
         CHECK(foundCmds == cmds);
         CHECK(history.size() == 4);
@@ -57,7 +60,7 @@ SCENARIO("multiple lines can be stored, accessed and iterated over") {
             THEN("the command is added to the history and the oldest command is overwritten") {
                 std::vector<std::string> expectedCmds{"cmd2", "cmd3", "cmd4", "cmd5"};
                 std::vector<std::string> actualCmds{};
-                for (auto cmd : history) { actualCmds.emplace_back(cmd.data()); }
+                for (auto cmd : history) { actualCmds.emplace_back(cmd); }
                 CHECK(actualCmds == expectedCmds);
                 CHECK(history.back() == "cmd5");
                 CHECK(history.front() == "cmd2");
@@ -75,9 +78,226 @@ SCENARIO("multiple lines can be stored, accessed and iterated over") {
             CAPTURE(s);
             THEN("the command is moved to the most recent position in the command history") {
                 std::vector<std::string> actualCmds{};
-                for (auto cmd : history) { actualCmds.emplace_back(cmd.data()); }
+                for (auto cmd : history) { actualCmds.emplace_back(cmd); }
                 CHECK(actualCmds == expected);
             }
         }
     }
-}
\ No newline at end of file
+}
+
+SCENARIO("lines containing some text can be found from newest to oldest") {
+    GIVEN("a history that has wrapped around its buffer") {
+        hh::shell::cmd_history<4, 18> history;
+        for (const auto *line : {"old led", "gpio set", "led on", "led off", "adc read", "gpio get"}) {
+            history.push_back(line);
+        }
+        auto newest = --history.end();
+
+        WHEN("searching from the newest line") {
+            auto match = history.rfind("led", newest);
+            THEN("the newest line containing the text is found") {
+                REQUIRE(match != history.end());
+                CHECK(*match == "led off");
+            }
+
+            AND_WHEN("searching again from the line before the match") {
+                auto older = history.rfind("led", --match);
+                THEN("the next older match is found") {
+                    REQUIRE(older != history.end());
+                    CHECK(*older == "led on");
+                }
+            }
+        }
+
+        WHEN("no line contains the text") {
+            THEN("end is returned") {
+                CHECK(history.rfind("old", newest) == history.end());
+                CHECK(history.rfind("lde", newest) == history.end());
+            }
+        }
+
+        WHEN("a line is moved to the end by pushing it again") {
+            history.push_back("led on");
+            THEN("it is found from its new position") {
+                CHECK(*history.rfind("on", --history.end()) == "led on");
+                CHECK(*history.rfind("get", --history.end()) == "gpio get");
+            }
+        }
+    }
+}
+
+SCENARIO("short lines are packed, so many more fit than lines of the maximum length") {
+    GIVEN("a history with space for two lines of the maximum length") {
+        hh::shell::cmd_history<2, 64> history;
+
+        WHEN("many short lines are pushed") {
+            for (int i = 0; i < 40; ++i) { history.push_back(("cmd " + std::to_string(i)).c_str()); }
+
+            THEN("the newest lines that fit are kept in order") {
+                std::vector<std::string> lines{};
+                for (auto line : history) { lines.emplace_back(line); }
+                CHECK(lines.size() == history.size());
+                CHECK(history.size() > 8);
+                CHECK(history.back() == "cmd 39");
+                for (std::size_t i = 1; i < lines.size(); ++i) {
+                    CHECK(std::stoi(lines[i].substr(4)) == std::stoi(lines[i - 1].substr(4)) + 1);
+                }
+            }
+
+            THEN("they can be walked from newest to oldest") {
+                std::vector<std::string> lines{};
+                for (auto it = history.end(); it != history.begin();) { lines.emplace_back(*--it); }
+                CHECK(lines.size() == history.size());
+                CHECK(lines.front() == "cmd 39");
+                CHECK(lines.back() == history.front());
+            }
+        }
+
+        WHEN("a line longer than the maximum is pushed") {
+            history.push_back(std::string(100, 'x').c_str());
+            THEN("it is cut short") { CHECK(history.back() == std::string(64, 'x')); }
+        }
+    }
+}
+
+SCENARIO("lines already in an indexed history are found by their hash") {
+    GIVEN("a history with an index") {
+        hh::shell::cmd_history<4, 64, 16> history;
+        CHECK(history.max_size() == 12);
+
+        WHEN("lines are pushed again in a different order") {
+            for (int round = 0; round < 3; ++round) {
+                for (int i = 0; i < 8; ++i) {
+                    int n = round % 2 == 0 ? i : 7 - i;
+                    history.push_back(("cmd " + std::to_string(n)).c_str());
+                }
+            }
+
+            THEN("each line is kept once, in the order last pushed") {
+                std::vector<std::string> lines{};
+                for (auto line : history) { lines.emplace_back(line); }
+                CHECK(lines == std::vector<std::string>{"cmd 0", "cmd 1", "cmd 2", "cmd 3",
+                                                        "cmd 4", "cmd 5", "cmd 6", "cmd 7"});
+                CHECK(history.size() == 8);
+            }
+        }
+
+        WHEN("more lines are pushed than the index can hold") {
+            for (int i = 0; i < 20; ++i) { history.push_back(("cmd " + std::to_string(i)).c_str()); }
+
+            THEN("the oldest lines are evicted") {
+                CHECK(history.size() == 12);
+                CHECK(history.front() == "cmd 8");
+                CHECK(history.back() == "cmd 19");
+
+                history.push_back("cmd 10");
+                CHECK(history.size() == 12);
+                CHECK(history.back() == "cmd 10");
+            }
+        }
+    }
+}
+
+TEST_CASE("erased lines are skipped in both directions") {
+    hh::shell::cmd_history<4, 16> history;
+    for (const auto *line : {"a", "b", "c", "d"}) { history.push_back(line); }
+    history.erase(++history.begin());
+    history.erase(history.begin());
+    history.erase(--history.end());
+
+    CHECK(history.size() == 1);
+    CHECK(history.front() == "c");
+    CHECK(history.back() == "c");
+
+    // Repeating the newest line leaves it where it is
+    history.push_back("c");
+    history.push_back("c");
+    CHECK(history.size() == 1);
+}
+
+static_assert(std::random_access_iterator<hh::shell::cmd_history<4, 16>::const_iterator>);
+// The line table shares the RAM of the lines, which many more short lines fit in
+static_assert(sizeof(hh::shell::cmd_history<8, 128>) <= 8 * (128 + 1) + 8 * sizeof(std::size_t));
+static_assert(sizeof(hh::shell::cmd_history<4, 64>) <= 4 * (64 + 1) + 8 * sizeof(std::size_t));
+
+TEST_CASE("lines are found by their number, which stays the same while other lines come and go") {
+    hh::shell::cmd_history<6, 16> history;
+    for (const auto *line : {"a", "b", "c", "d", "e", "b"}) { history.push_back(line); }
+    history.erase(history.find_number(3));
+
+    REQUIRE(history.size() == 4);
+    CHECK(history.begin().number() == 1);
+    CHECK(*history.find_number(1) == "a");
+    CHECK(*history.find_number(4) == "d");
+    CHECK(*history.find_number(6) == "b");
+    // Erased and repeated lines leave gaps in the numbers
+    CHECK(history.find_number(2) == history.end());
+    CHECK(history.find_number(3) == history.end());
+    CHECK(history.find_number(7) == history.end());
+
+    auto it = history.find_number(4);
+    CHECK(*++it == "e");
+    CHECK(*--it == "d");
+    CHECK(*--it == "a");
+    CHECK(it == history.begin());
+
+    // Offsets move over the numbers through the table, erased lines are empty
+    CHECK(*(history.begin() + 3) == "d");
+    CHECK((history.begin() + 2)->empty());
+    CHECK(history.begin()[5] == "b");
+    CHECK(history[3] == "d");
+    CHECK(history.end() - history.begin() == 6);
+    CHECK(history.end() - 1 == --history.end());
+
+    // Lines are not renumbered when the oldest are evicted, or erased lines are compacted away
+    for (int i = 0; i < 20; ++i) { history.push_back(("line " + std::to_string(i)).c_str()); }
+    auto newest = --history.end();
+    CHECK(newest.number() == 26);
+    history.push_back(std::string{*history.find_number(22)});
+    history.push_back(std::string{*history.find_number(24)});
+    history.push_back("line 20");
+    CHECK(history.begin().number() == 21);
+    CHECK(*history.find_number(21) == "line 14");
+    CHECK(history.find_number(22) == history.end());
+    CHECK(*history.find_number(23) == "line 16");
+    CHECK(history.find_number(24) == history.end());
+    CHECK(*history.find_number(26) == "line 19");
+    CHECK(*history.find_number(27) == "line 15");
+    CHECK(*history.find_number(28) == "line 17");
+    CHECK(*history.find_number(29) == "line 20");
+}
+
+namespace {
+    /// \brief The shortest time taken by a run of pushes to a full history, alternating between repeating an
+    /// older line and pushing a new one
+    template<class History>
+    std::chrono::nanoseconds repeated_push_time() {
+        constexpr std::size_t runs = 5;
+        constexpr std::size_t pushes = 1000;
+        std::vector<std::string> lines;
+        for (std::size_t i = 0; i < (runs + 1) * pushes; ++i) {
+            lines.push_back("line " + std::to_string(10000 + i));
+        }
+
+        History history;
+        std::size_t next = 0;
+        for (; next < pushes; ++next) { history.push_back(lines[next]); }
+        auto best = std::chrono::nanoseconds::max();
+        for (std::size_t run = 0; run < runs; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < pushes; ++i) {
+                history.push_back(lines[next - 20]);
+                history.push_back(lines[next++]);
+            }
+            best = std::min(best, std::chrono::nanoseconds{std::chrono::steady_clock::now() - start});
+        }
+        return best;
+    }
+}// namespace
+
+TEST_CASE("the cost of repeating a line does not grow with the size of the history") {
+    auto small = repeated_push_time<hh::shell::cmd_history<32, 16, 128>>();
+    auto large = repeated_push_time<hh::shell::cmd_history<512, 16, 1024>>();
+    CAPTURE(small.count(), large.count());
+    CHECK(large < small * 4);
+}
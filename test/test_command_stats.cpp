@@ -0,0 +1,70 @@
+/// \file test_command_stats.cpp
+/// \brief Tests for command run time statistics
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <hh/command_stats.hpp>
+#include <string>
+
+using hh::shell::command_stats;
+
+namespace {
+    struct mock_output {
+        std::string written{};
+        void write(const char *s, std::size_t count) { written.append(s, count); }
+        void flush() {}
+    };
+
+    int noop(hh::shell::command::argv_type, hh::shell::cmd_ostream &) { return 0; }
+
+    constexpr hh::shell::command_table stats_commands{{
+            {noop, "first", ""},
+            {noop, "second", ""},
+    }};
+}// namespace
+
+TEST_CASE("run times are counted in log scale buckets", "[command_stats]") {
+    CHECK(command_stats::bucket(0) == 0);
+    CHECK(command_stats::bucket(1) == 1);
+    CHECK(command_stats::bucket(2) == 2);
+    CHECK(command_stats::bucket(3) == 2);
+    CHECK(command_stats::bucket(4) == 3);
+    CHECK(command_stats::bucket(1024) == 11);
+    CHECK(command_stats::bucket(UINT32_MAX) == command_stats::num_buckets - 1);
+
+    command_stats stats;
+    stats.record(3);
+    stats.record(2);
+    stats.record(40);
+
+    CHECK(stats.calls == 3);
+    CHECK(stats.max_ticks == 40);
+    CHECK(stats.buckets[2] == 2);
+    CHECK(stats.buckets[6] == 1);
+
+    stats.reset();
+    CHECK(stats.calls == 0);
+    CHECK(stats.max_ticks == 0);
+    CHECK(stats.buckets[2] == 0);
+}
+
+TEST_CASE("bucket counts saturate", "[command_stats]") {
+    command_stats stats;
+    stats.buckets[0] = UINT16_MAX;
+    stats.record(0);
+    CHECK(stats.buckets[0] == UINT16_MAX);
+    CHECK(stats.calls == 1);
+}
+
+TEST_CASE("statistics are printed for commands that have run", "[command_stats]") {
+    mock_output device;
+    hh::shell::output_sink sink{device};
+    hh::shell::cmd_ostream out{sink};
+    command_stats stats[2];
+    stats[1].record(5);
+
+    hh::shell::print_command_stats(out, stats_commands, stats);
+
+    CHECK(device.written == "command calls max histogram\n\r"
+                            "second 1 5 0 0 0 1 0 0 0 0 0 0 0 0\n\r");
+}
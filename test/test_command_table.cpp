@@ -0,0 +1,80 @@
+/// \file test_command_table.cpp
+/// \brief Tests for the compile time command lookup table
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <hh/command_table.hpp>
+#include <string>
+
+using namespace std::string_literals;
+
+namespace {
+    int noop(hh::shell::command::argv_type, hh::shell::cmd_ostream &) { return 0; }
+
+    constexpr hh::shell::command_table commands{{
+            {noop, "help", "prints help"},
+            {noop, "led", "sets an led"},
+            {noop, "reset", "resets the device"},
+            {noop, "dump", "dumps memory"},
+            {noop, "a", "a"},
+            {noop, "q", "q"},
+            {noop, "gpio_read", "reads a gpio pin"},
+            {noop, "gpio_write", "writes a gpio pin"},
+            {noop, "adc", "reads the adc"},
+            {noop, "version", "prints the version"},
+    }};
+}// namespace
+
+TEST_CASE("command table lookups are resolved at compile time", "[commands]") {
+    static_assert(commands.size() == 10);
+    static_assert(commands.find("reset") == &commands.begin()[2]);
+    static_assert(commands.find("rese") == nullptr);
+    static_assert(commands.find("") == nullptr);
+}
+
+TEST_CASE("every command in the table can be found by name", "[commands]") {
+    hh::shell::command_set set = commands;
+    CHECK(set.size() == commands.size());
+
+    for (const auto &cmd : commands) {
+        CAPTURE(cmd.cmd_name);
+        CHECK(set.find(cmd.cmd_name) == &cmd);
+    }
+}
+
+TEST_CASE("names not in the table are not found", "[commands]") {
+    hh::shell::command_set set = commands;
+    auto name = GENERATE("helpp"s, "hel"s, "LED"s, "b"s, "gpio"s, "version "s, ""s);
+    CAPTURE(name);
+    CHECK(set.find(name) == nullptr);
+}
+
+TEST_CASE("an empty command set finds nothing", "[commands]") {
+    hh::shell::command_set set{};
+    CHECK(set.empty());
+    CHECK(set.find("help") == nullptr);
+}
+
+TEST_CASE("large command tables build a collision free hash", "[commands]") {
+    static constexpr auto names = [] {
+        std::array<std::array<char, 8>, 64> names{};
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            names[i] = {'c', 'm', 'd', '_', static_cast<char>('0' + i / 10), static_cast<char>('0' + i % 10), 0};
+        }
+        return names;
+    }();
+    static constexpr auto table = [] {
+        hh::shell::command cmds[names.size()]{};
+        for (std::size_t i = 0; i < names.size(); ++i) { cmds[i] = {noop, names[i].data(), ""}; }
+        return hh::shell::command_table{cmds};
+    }();
+
+    for (const auto &name : names) {
+        CAPTURE(name.data());
+        auto cmd = table.find(name.data());
+        REQUIRE(cmd != nullptr);
+        CHECK(cmd->cmd_name == std::string_view{name.data()});
+    }
+    CHECK(table.find("cmd_64") == nullptr);
+}
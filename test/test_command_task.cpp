@@ -0,0 +1,114 @@
+/// \file test_command_task.cpp
+/// \brief Tests for coroutine command tasks
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <hh/command_task.hpp>
+#include <vector>
+
+using hh::shell::command_task;
+using hh::shell::wait_reason;
+
+namespace {
+    command_task count_to(int n, int &count) {
+        for (int i = 0; i < n; ++i) {
+            ++count;
+            co_await hh::shell::sleep_for{1};
+        }
+        co_return n;
+    }
+
+    command_task echo_input(int &received) {
+        received = co_await hh::shell::next_char{};
+        co_await hh::shell::tx_ready{};
+        co_return 0;
+    }
+}// namespace
+
+SCENARIO("command tasks run until they wait for something") {
+    GIVEN("a task that sleeps between counts") {
+        int count = 0;
+        auto task = count_to(3, count);
+
+        THEN("the task runs up to the first suspension") {
+            REQUIRE(task.valid());
+            CHECK(task.running());
+            CHECK(count == 1);
+            CHECK(task.promise().waiting == wait_reason::ticks);
+            CHECK(task.promise().ticks == 1);
+        }
+
+        WHEN("the task is resumed until it is done") {
+            while (task.running()) { task.resume(); }
+            THEN("the task returns its result") {
+                CHECK(count == 3);
+                CHECK(task.result() == 3);
+            }
+        }
+
+        WHEN("the task is reset") {
+            task.reset();
+            THEN("the task is cancelled") {
+                CHECK(!task.valid());
+                CHECK(count == 1);
+            }
+        }
+    }
+
+    GIVEN("a task waiting for input") {
+        int received = 0;
+        auto task = echo_input(received);
+        CHECK(task.promise().waiting == wait_reason::input);
+
+        WHEN("input is passed to the task") {
+            task.promise().input = 'x';
+            task.resume();
+            THEN("the task receives the input") {
+                CHECK(received == 'x');
+                CHECK(task.promise().waiting == wait_reason::tx_ready);
+            }
+        }
+    }
+}
+
+TEST_CASE("command task frames come from a fixed size pool", "[command_task]") {
+    int count = 0;
+    std::vector<command_task> tasks{};
+    for (std::size_t i = 0; i < hh::shell::default_max_command_frames; ++i) {
+        tasks.push_back(count_to(2, count));
+        CHECK(tasks.back().valid());
+    }
+
+    auto noFrame = count_to(2, count);
+    CHECK(!noFrame.valid());
+    CHECK(count == hh::shell::default_max_command_frames);
+
+    tasks.back().reset();
+    auto freedFrame = count_to(2, count);
+    CHECK(freedFrame.valid());
+}
+
+namespace {
+    struct counting_lock {
+        int locks{0};
+        bool held{false};
+        void lock() {
+            ++locks;
+            held = true;
+        }
+        void unlock() { held = false; }
+    };
+}// namespace
+
+TEST_CASE("frames are taken from and returned to the pool under its lock") {
+    counting_lock lock;
+    hh::shell::attach_frame_pool(hh::shell::default_frame_pool(), hh::shell::lock_ref{lock});
+    {
+        int count = 0;
+        auto task = count_to(1, count);
+        CHECK(lock.locks == 1);
+    }
+    CHECK(lock.locks == 2);
+    CHECK_FALSE(lock.held);
+    hh::shell::detach_frame_pool();
+}
@@ -0,0 +1,83 @@
+/// \file test_completion_trie.cpp
+/// \brief Tests for completing command names and keywords
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <hh/completion_trie.hpp>
+#include <string>
+#include <tuple>
+
+using namespace std::string_literals;
+
+namespace {
+    int noop(hh::shell::command::argv_type, hh::shell::cmd_ostream &) { return 0; }
+
+    constexpr const char *led_keywords[] = {"on", "off", "toggle", nullptr};
+
+    constexpr hh::shell::command_table commands{{
+            {noop, "help", "prints help"},
+            {noop, "led", "sets an led", led_keywords},
+            {noop, "gpio_read", "reads a gpio pin"},
+            {noop, "gpio_write", "writes a gpio pin"},
+            {noop, "reset", "resets the device"},
+            {noop, "reset_all", "resets everything"},
+    }};
+
+    constexpr hh::shell::completion_trie<commands> trie{};
+
+    struct completion_result {
+        std::string suffix;
+        bool found;
+        bool unique;
+        bool operator==(const completion_result &) const = default;
+    };
+}// namespace
+
+TEST_CASE("completion tries are sized to the distinct prefixes", "[completion]") {
+    // root, help, led, gpio_, read, write, reset, _all, keyword root, on, f, f, toggle
+    static_assert(trie.size() == 1 + 4 + 3 + 5 + 4 + 5 + 5 + 4 + 1 + 2 + 2 + 6);
+}
+
+TEST_CASE("command names are completed up to the next ambiguous char", "[completion]") {
+    auto [prefix, expected] = GENERATE(
+            std::tuple{"h"s, completion_result{"elp", true, true}},
+            std::tuple{"help"s, completion_result{"", true, true}},
+            std::tuple{"g"s, completion_result{"pio_", true, false}},
+            std::tuple{"gpio_w"s, completion_result{"rite", true, true}},
+            std::tuple{"res"s, completion_result{"et", true, false}},
+            std::tuple{"reset"s, completion_result{"", true, false}},
+            std::tuple{""s, completion_result{"", true, false}},
+            std::tuple{"x"s, completion_result{"", false, false}},
+            std::tuple{"helpx"s, completion_result{"", false, false}});
+
+    CAPTURE(prefix);
+    hh::shell::completion_set set = trie;
+    char suffix[32];
+    auto result = set.complete_command(prefix, suffix, sizeof(suffix));
+
+    CHECK(completion_result{{suffix, result.length}, result.found, result.unique} == expected);
+}
+
+TEST_CASE("keywords are completed per command", "[completion]") {
+    hh::shell::completion_set set = trie;
+    char suffix[32];
+
+    auto result = set.complete_keyword(commands.begin()[1], "t", suffix, sizeof(suffix));
+    CHECK(completion_result{{suffix, result.length}, result.found, result.unique} == completion_result{"oggle", true, true});
+
+    result = set.complete_keyword(commands.begin()[1], "o", suffix, sizeof(suffix));
+    CHECK(completion_result{{suffix, result.length}, result.found, result.unique} == completion_result{"", true, false});
+
+    result = set.complete_keyword(commands.begin()[0], "o", suffix, sizeof(suffix));
+    CHECK(!result.found);
+}
+
+TEST_CASE("completions are limited to the size of the suffix buffer", "[completion]") {
+    hh::shell::completion_set set = trie;
+    char suffix[2];
+    auto result = set.complete_command("gpio_w", suffix, sizeof(suffix));
+
+    CHECK(std::string{suffix, result.length} == "ri");
+    CHECK(!result.unique);
+}
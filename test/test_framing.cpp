@@ -0,0 +1,102 @@
+/// \file test_framing.cpp
+/// \brief Tests for COBS framed packets with a CRC
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <hh/framing.hpp>
+#include <string>
+
+using namespace std::string_literals;
+
+namespace {
+    struct string_output {
+        std::string data{};
+        void write(const char *s, std::size_t count) { data.append(s, count); }
+    };
+
+    std::string encode(const std::string &data) {
+        string_output out;
+        hh::shell::cobs_encode(out, data);
+        return out.data;
+    }
+
+    std::string decode(std::string frame) {
+        std::size_t size = 0;
+        REQUIRE(hh::shell::cobs_decode(frame, size));
+        return frame.substr(0, size);
+    }
+}// namespace
+
+TEST_CASE("COBS encoding removes zeros from the packet", "[framing][cobs]") {
+    CHECK(encode(""s) == "\x01"s);
+    CHECK(encode("\0"s) == "\x01\x01"s);
+    CHECK(encode("\0\0"s) == "\x01\x01\x01"s);
+    CHECK(encode("\x11\x22\0\x33"s) == "\x03\x11\x22\x02\x33"s);
+    CHECK(encode("\x11\x22\x33\x44"s) == "\x05\x11\x22\x33\x44"s);
+    CHECK(encode("\x11\0\0\0"s) == "\x02\x11\x01\x01\x01"s);
+}
+
+TEST_CASE("COBS encoding splits runs of more than 254 non zero bytes", "[framing][cobs]") {
+    std::string run(254, 'a');
+    CHECK(encode(run) == "\xff"s + run);
+    CHECK(encode(run + "b") == "\xff"s + run + "\x02"s + "b");
+    CHECK(encode(run + "\0"s) == "\xff"s + run + "\x01\x01"s);
+    CHECK(encode(run).size() <= hh::shell::cobs_max_encoded_size(run.size()));
+}
+
+TEST_CASE("COBS decoding reverses encoding in place", "[framing][cobs]") {
+    std::string run(300, 'a');
+    run[100] = '\0';
+    for (const auto &packet : {""s, "\0"s, "\x11\0\0\0"s, "\x11\x22\0\x33"s, std::string(254, 'b'), run}) {
+        CHECK(decode(encode(packet)) == packet);
+    }
+}
+
+TEST_CASE("COBS frames with codes past the end of the frame are rejected", "[framing][cobs]") {
+    std::string frame{"\x05\x11\x22"};
+    std::size_t size = 0;
+    CHECK_FALSE(hh::shell::cobs_decode(frame, size));
+}
+
+TEST_CASE("packets are checked against the CRC in their last two bytes", "[framing][crc]") {
+    CHECK(hh::shell::crc16("123456789"s) == 0x29b1);
+
+    std::string packet{"\x07\x03set"};
+    auto crc = hh::shell::crc16(packet);
+    packet += static_cast<char>(crc & 0xff);
+    packet += static_cast<char>(crc >> 8);
+    CHECK(hh::shell::check_packet(packet));
+
+    packet[1] = '\x04';
+    CHECK_FALSE(hh::shell::check_packet(packet));
+    CHECK_FALSE(hh::shell::check_packet("\x01\x02"s));
+}
+
+TEST_CASE("request arguments are split on their length bytes", "[framing]") {
+    std::string_view args[3];
+    auto data = "\x03set\x00\x02\x01\x02"s;
+
+    auto result = hh::shell::decode_frame_args(data, args);
+    REQUIRE(result.good());
+    CHECK(result.argc == 3);
+    CHECK(args[0] == "set");
+    CHECK(args[1].empty());
+    CHECK(args[2] == "\x01\x02");
+
+    CHECK(hh::shell::decode_frame_args("\x05" "ab"s, args).result ==
+          hh::shell::frame_args_result::status::truncated);
+    CHECK(hh::shell::decode_frame_args("\x01" "a\x01" "b\x01" "c\x01" "d"s, args).result ==
+          hh::shell::frame_args_result::status::too_many_args);
+}
+
+TEST_CASE("responses hold the sequence ID, status and output, and are cut short when full", "[framing]") {
+    hh::shell::frame_response<8> response;
+    response.start(9);
+    CHECK(response.write("abcd", 4) == 3);
+    CHECK(response.output_size() == 3);
+
+    auto packet = response.finish(-2);
+    std::string expected{"\x09\xfe\xff\xff\xff" "abc"};
+    CHECK(std::string(packet.data(), packet.size() - 2) == expected);
+    CHECK(hh::shell::check_packet(packet));
+}
@@ -0,0 +1,156 @@
+/// \file test_gap_buffer.cpp
+/// \brief Tests for the line editing gap buffer
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <hh/gap_buffer.hpp>
+#include <string>
+
+using namespace std::string_literals;
+using gap_buffer = hh::container::gap_buffer<16>;
+
+namespace {
+    std::string indexed_contents(const gap_buffer &buffer) {
+        std::string s{};
+        for (std::size_t i = 0; i < buffer.size(); ++i) { s += buffer[i]; }
+        return s;
+    }
+}// namespace
+
+SCENARIO("gap buffers can be edited at the cursor") {
+    GIVEN("a default constructed buffer") {
+        gap_buffer buffer{};
+
+        CHECK(buffer.empty());
+        CHECK(buffer.size() == 0);
+        CHECK(buffer.cursor() == 0);
+        CHECK(buffer.view() == ""s);
+
+        WHEN("chars are inserted") {
+            for (char ch : "abc"s) { CHECK(buffer.insert(ch)); }
+            THEN("they are appended and the cursor follows them") {
+                CHECK(buffer.view() == "abc"s);
+                CHECK(buffer.cursor() == 3);
+            }
+        }
+
+        WHEN("erase is called") {
+            THEN("nothing is erased") {
+                CHECK(!buffer.erase_before());
+                CHECK(!buffer.erase_after());
+                CHECK(buffer.empty());
+            }
+        }
+    }
+
+    GIVEN("a buffer with the cursor in the middle") {
+        gap_buffer buffer{"hello world"};
+        CHECK(buffer.cursor() == 11);
+        buffer.move_cursor(-6);
+        CHECK(buffer.cursor() == 5);
+
+        WHEN("chars are inserted") {
+            buffer.insert(',');
+            THEN("they are inserted before the cursor") {
+                CHECK(buffer.view() == "hello, world"s);
+                CHECK(buffer.cursor() == 6);
+            }
+        }
+
+        WHEN("a string is inserted") {
+            CHECK(buffer.insert(" big", 4) == 4);
+            THEN("it is inserted before the cursor") {
+                CHECK(buffer.view() == "hello big world"s);
+                CHECK(buffer.cursor() == 9);
+            }
+        }
+
+        WHEN("the text is read from a const buffer after an edit") {
+            CHECK(buffer.insert(" big", 4) == 4);
+            const auto &constBuffer = buffer;
+            THEN("the text is contiguous without moving the cursor") {
+                CHECK(constBuffer.view() == "hello big world"s);
+                CHECK(std::string_view{constBuffer.c_str()} == "hello big world"s);
+                CHECK(constBuffer.cursor() == 9);
+            }
+        }
+
+        WHEN("erase before is called") {
+            CHECK(buffer.erase_before());
+            THEN("the char before the cursor is erased") {
+                CHECK(buffer.view() == "hell world"s);
+                CHECK(buffer.cursor() == 4);
+            }
+        }
+
+        WHEN("erase after is called") {
+            CHECK(buffer.erase_after());
+            THEN("the char after the cursor is erased") {
+                CHECK(buffer.view() == "helloworld"s);
+                CHECK(buffer.cursor() == 5);
+            }
+        }
+
+        WHEN("edits are made at different positions") {
+            buffer.insert('!');
+            buffer.set_cursor(0);
+            buffer.insert('>');
+            buffer.move_cursor(100);
+            buffer.erase_before();
+            buffer.move_cursor(-100);
+            buffer.erase_after();
+            THEN("each edit is made at the cursor") {
+                CHECK(indexed_contents(buffer) == "hello! worl"s);
+                CHECK(buffer.view() == "hello! worl"s);
+                CHECK(buffer.cursor() == 0);
+            }
+        }
+
+        WHEN("several chars are erased before the cursor") {
+            THEN("at most the chars before the cursor are erased") {
+                CHECK(buffer.erase_before(3) == 3);
+                CHECK(buffer.erase_before(3) == 2);
+                CHECK(buffer.view() == " world"s);
+                CHECK(buffer.cursor() == 0);
+            }
+        }
+
+        WHEN("chars are written to the gap and committed") {
+            auto before = buffer.view().substr(0, 5);
+            auto gap = buffer.gap();
+            CHECK(gap.size() == 5);
+            std::copy_n("abc", 3, gap.data());
+            buffer.commit(3);
+            THEN("they are inserted at the cursor, and the chars before it stay in place") {
+                CHECK(before == "hello"s);
+                CHECK(indexed_contents(buffer) == "helloabc world"s);
+                CHECK(buffer.cursor() == 8);
+            }
+        }
+
+        WHEN("the contents are requested") {
+            auto s = buffer.c_str();
+            THEN("they are contiguous and null terminated, and the cursor is unchanged") {
+                CHECK(s == "hello world"s);
+                CHECK(buffer.cursor() == 5);
+            }
+        }
+    }
+
+    GIVEN("a full buffer") {
+        gap_buffer buffer{"0123456789abcdefgh"};
+        CHECK(buffer.full());
+        CHECK(buffer.view() == "0123456789abcdef"s);
+
+        WHEN("chars are inserted") {
+            buffer.set_cursor(4);
+            THEN("the buffer is unmodified") {
+                CHECK(!buffer.insert('x'));
+                CHECK(buffer.insert("xyz", 3) == 0);
+                CHECK(buffer.view() == "0123456789abcdef"s);
+                CHECK(buffer.cursor() == 4);
+            }
+        }
+    }
+}
@@ -0,0 +1,156 @@
+/// \file test_history_log.cpp
+/// \brief Tests for the log the history is kept in across resets
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <hh/file_storage.hpp>
+#include <hh/history_log.hpp>
+#include <string>
+#include <vector>
+
+namespace {
+    /// \brief Flash like storage, checking that only erased bytes are programmed
+    struct memory_storage {
+        static constexpr std::size_t size = 32;
+        std::vector<std::string> pages = std::vector<std::string>(4, std::string(size, '\xff'));
+        std::vector<int> erases = std::vector<int>(4, 0);
+        std::size_t programs{0};
+
+        [[nodiscard]] std::size_t page_size() const { return size; }
+        [[nodiscard]] std::size_t page_count() const { return pages.size(); }
+
+        void read(std::size_t page, std::size_t offset, std::span<char> out) {
+            std::copy_n(pages[page].begin() + static_cast<std::ptrdiff_t>(offset), out.size(), out.begin());
+        }
+        void program(std::size_t page, std::size_t offset, std::span<const char> in) {
+            ++programs;
+            for (std::size_t i = 0; i < in.size(); ++i) {
+                REQUIRE(pages[page][offset + i] == '\xff');
+                pages[page][offset + i] = in[i];
+            }
+        }
+        void erase(std::size_t page) {
+            ++erases[page];
+            pages[page].assign(size, '\xff');
+        }
+    };
+
+    static_assert(hh::shell::block_storage<memory_storage>);
+    static_assert(hh::shell::block_storage<hh::shell::file_storage>);
+
+    using log_t = hh::shell::history_log<memory_storage, 16, 8>;
+
+    template<class Log>
+    std::vector<std::string> replay(Log &log) {
+        std::vector<std::string> lines;
+        log.replay([&](std::string_view line) { lines.emplace_back(line); });
+        return lines;
+    }
+}// namespace
+
+SCENARIO("lines appended to the log are replayed after a reset", "[history_log]") {
+    GIVEN("a log with some lines") {
+        memory_storage storage;
+        {
+            log_t log{storage};
+            for (const auto *line : {"led on", "", "gpio get 4"}) { log.append(line); }
+            log.flush();
+        }
+
+        WHEN("a new log is opened on the same storage") {
+            log_t log{storage};
+            THEN("the lines are replayed oldest first, without the empty line") {
+                CHECK(replay(log) == std::vector<std::string>{"led on", "gpio get 4"});
+            }
+
+            AND_WHEN("more lines are appended") {
+                log.append("led off");
+                THEN("they follow the earlier lines") {
+                    CHECK(replay(log) == std::vector<std::string>{"led on", "gpio get 4", "led off"});
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("the log reads nothing until it is used, and programs lines a batch at a time", "[history_log]") {
+    memory_storage storage;
+    log_t log{storage};
+    CHECK(storage.programs == 0);
+    CHECK(storage.erases[0] == 0);
+
+    // The header is programmed when the first page is started
+    log.append("ab");
+    log.append("cd");
+    CHECK(storage.programs == 1);
+    log.append("ef");
+    CHECK(storage.programs == 2);
+    log.flush();
+    CHECK(storage.programs == 3);
+
+    // Lines longer than a batch are programmed on their own
+    log.append("0123456789");
+    CHECK(storage.programs == 6);
+    CHECK(replay(log) == std::vector<std::string>{"ab", "cd", "ef", "0123456789"});
+}
+
+TEST_CASE("the log moves through the pages in turn, erasing the oldest", "[history_log]") {
+    memory_storage storage;
+    log_t log{storage};
+    std::vector<std::string> lines;
+    for (int i = 10; i < 100; ++i) {
+        lines.push_back("line " + std::to_string(i));
+        log.append(lines.back());
+    }
+    log.flush();
+
+    // Each 32 char page holds 2 lines, so 45 pages were started in turn
+    for (int erases : storage.erases) { CHECK((erases == 11 || erases == 12)); }
+
+    log_t reopened{storage};
+    auto replayed = replay(reopened);
+    REQUIRE(replayed.size() == 8);
+    CHECK(std::equal(replayed.begin(), replayed.end(), lines.end() - 8));
+}
+
+TEST_CASE("a line cut short by a reset is ignored, and the log carries on in the next page", "[history_log]") {
+    memory_storage storage;
+    {
+        log_t log{storage};
+        log.append("first");
+        log.flush();
+    }
+    // The length and chars of a line were programmed, but not its inverted length
+    auto &page = storage.pages[0];
+    auto end = page.find('\xff', log_t::header_size);
+    page.replace(end, 4, "\x03" "abc");
+
+    log_t log{storage};
+    CHECK(replay(log) == std::vector<std::string>{"first"});
+    log.append("second");
+    log.flush();
+    CHECK(storage.erases[1] == 1);
+    CHECK(replay(log) == std::vector<std::string>{"first", "second"});
+}
+
+TEST_CASE("file storage keeps the log between runs", "[history_log][file_storage]") {
+    auto path = (std::filesystem::temp_directory_path() / "hh_test_history_log.bin").string();
+    std::remove(path.c_str());
+    {
+        hh::shell::file_storage storage{path.c_str(), 64, 2};
+        REQUIRE(storage.is_open());
+        hh::shell::history_log<hh::shell::file_storage, 32> log{storage};
+        log.append("led on");
+        log.append("led off");
+        log.flush();
+    }
+    {
+        hh::shell::file_storage storage{path.c_str(), 64, 2};
+        hh::shell::history_log<hh::shell::file_storage, 32> log{storage};
+        CHECK(replay(log) == std::vector<std::string>{"led on", "led off"});
+    }
+    std::remove(path.c_str());
+}
@@ -0,0 +1,72 @@
+/// \file test_line_renderer.cpp
+/// \brief Tests for redrawing edited lines
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <hh/line_renderer.hpp>
+#include <hh/mini_stream.hpp>
+#include <sstream>
+#include <string>
+#include <tuple>
+
+using namespace std::string_literals;
+
+namespace {
+    struct renderer_fixture {
+        std::stringstream ss{};
+        hh::shell::oserial_stream<std::stringstream> out{ss};
+        hh::ansi::line_renderer<32> renderer{};
+
+        std::string render(std::string_view line, std::size_t cursor) {
+            ss.str("");
+            renderer.render(out, line, cursor);
+            return ss.str();
+        }
+    };
+}// namespace
+
+TEST_CASE("rendering an unchanged line sends nothing", "[renderer]") {
+    renderer_fixture f;
+    f.render("abc", 3);
+    CHECK(f.render("abc", 3).empty());
+}
+
+TEST_CASE("lines are updated with the minimal terminal output", "[renderer]") {
+    auto [before, beforeCursor, after, afterCursor, expected] = GENERATE(
+            // typing at the end of the line only echoes the new chars
+            std::tuple{"ab"s, 2, "abc"s, 3, "c"s},
+            // backspace at the end of the line
+            std::tuple{"abc"s, 3, "ab"s, 2, "\b \b"s},
+            // deleting a char in the middle of the line
+            std::tuple{"abcdef"s, 3, "abdef"s, 2, "\b\x1b[P"s},
+            // inserting a char in the middle of the line
+            std::tuple{"abcdef"s, 3, "abcxdef"s, 4, "\x1b[@x"s},
+            // replacing the line with a longer line
+            std::tuple{"cmd3"s, 4, "cmd42"s, 5, "\b42"s},
+            // replacing the line with a much shorter line
+            std::tuple{"a long line"s, 11, "ab"s, 2, "\x1b[10Db\x1b[K"s},
+            // moving the cursor left
+            std::tuple{"abcdef"s, 6, "abcdef"s, 4, "\b\b"s},
+            std::tuple{"abcdefghij"s, 10, "abcdefghij"s, 0, "\x1b[10D"s},
+            // moving the cursor right rewrites the chars it passes over
+            std::tuple{"abcdef"s, 0, "abcdef"s, 2, "ab"s},
+            std::tuple{"abcdefghij"s, 0, "abcdefghij"s, 8, "\x1b[8C"s});
+
+    CAPTURE(before, beforeCursor, after, afterCursor);
+    renderer_fixture f;
+    f.render(before, before.size());
+    f.render(before, beforeCursor);
+
+    CHECK(f.render(after, afterCursor) == expected);
+    CHECK(f.renderer.drawn_size() == after.size());
+    CHECK(f.renderer.drawn_cursor() == static_cast<std::size_t>(afterCursor));
+}
+
+TEST_CASE("reset marks the drawn line as empty", "[renderer]") {
+    renderer_fixture f;
+    f.render("abc", 3);
+    f.renderer.reset();
+
+    CHECK(f.render("abc", 3) == "abc");
+}
@@ -59,6 +59,16 @@ TEST_CASE("mini_ostream string stream inserter", "[ostream][stream_inserter]") {
     CHECK(ss.str() == str);
 }
 
+TEST_CASE("mini_ostream string view stream inserter", "[ostream][stream_inserter]") {
+    std::stringstream ss;
+    mini_ostream stream{ss};
+
+    std::string_view str{"abcdefg"};
+    stream << str.substr(1, 3);
+
+    CHECK(ss.str() == "bcd");
+}
+
 TEMPLATE_TEST_CASE("mini_ostream int stream inserter", "[ostream][stream_inserter]", signed char, short, int) {
     std::stringstream ss;
     mini_ostream stream{ss};
@@ -78,4 +88,29 @@ TEMPLATE_TEST_CASE("mini_ostream uint stream inserter", "[ostream][stream_insert
     stream << i;
     CAPTURE(i);
     CHECK(ss.str() == std::to_string(i));
-}
\ No newline at end of file
+}
+
+namespace {
+    struct counting_lock {
+        int *locks;
+        int *unlocks;
+        void lock() { ++*locks; }
+        void unlock() { ++*unlocks; }
+    };
+}// namespace
+
+TEST_CASE("mini_ostream messages hold the lock once for all their writes", "[ostream][lock]") {
+    std::stringstream ss;
+    int locks = 0;
+    int unlocks = 0;
+    counting_lock lock{&locks, &unlocks};
+    hh::shell::oserial_stream<std::stringstream, counting_lock> stream{ss, lock};
+
+    stream << "no lock";
+    CHECK(locks == 0);
+
+    stream.begin_message() << 'a' << "bc" << 12;
+    CHECK(ss.str() == "no lockabc12");
+    CHECK(locks == 1);
+    CHECK(unlocks == 1);
+}
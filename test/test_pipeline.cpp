@@ -0,0 +1,234 @@
+/// \file test_pipeline.cpp
+/// \brief Tests for running commands as pipelines
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cctype>
+#include <hh/pipeline.hpp>
+#include <string>
+
+using hh::shell::cmd_ostream;
+using hh::shell::command;
+using hh::shell::command_task;
+using hh::shell::pipeline_stage;
+
+namespace {
+    struct mock_output {
+        std::string written{};
+        void write(const char *s, std::size_t count) { written.append(s, count); }
+        void flush() {}
+    };
+
+    // Writes its argument count times
+    int repeat(command::argv_type argv, cmd_ostream &out) {
+        for (int i = 0; i < std::stoi(std::string{argv[2]}); ++i) { out << argv[1]; }
+        return 0;
+    }
+
+    command_task upper(command::argv_type, cmd_ostream &out) {
+        // GCC 12 miscompiles co_await in loop conditions, so the loops test the char in the body
+        while (true) {
+            int ch = co_await hh::shell::next_char{};
+            if (ch == hh::shell::end_of_input) { break; }
+            out << static_cast<char>(std::toupper(ch));
+        }
+        co_return 1;
+    }
+
+    command_task count(command::argv_type, cmd_ostream &out) {
+        int n = 0;
+        while (true) {
+            int ch = co_await hh::shell::next_char{};
+            if (ch == hh::shell::end_of_input) { break; }
+            ++n;
+        }
+        out << n;
+        co_return n;
+    }
+
+    command_task head(command::argv_type argv, cmd_ostream &out) {
+        auto n = static_cast<std::size_t>(std::stoi(std::string{argv[1]}));
+        for (std::size_t i = 0; i < n; ++i) {
+            int ch = co_await hh::shell::next_char{};
+            if (ch == hh::shell::end_of_input) { break; }
+            out << static_cast<char>(ch);
+        }
+        co_return 2;
+    }
+
+    command_task sleepy(command::argv_type, cmd_ostream &out) {
+        co_await hh::shell::sleep_for{1};
+        out << "slept ";
+        co_return 3;
+    }
+
+    constexpr command repeat_cmd{repeat, "repeat", ""};
+    constexpr command upper_cmd{.cmd_name = "upper", .help_message = "", .execute_async = upper};
+    constexpr command count_cmd{.cmd_name = "count", .help_message = "", .execute_async = count};
+    constexpr command head_cmd{.cmd_name = "head", .help_message = "", .execute_async = head};
+    constexpr command sleepy_cmd{.cmd_name = "sleepy", .help_message = "", .execute_async = sleepy};
+}// namespace
+
+TEST_CASE("output larger than the pipes streams through the pipeline", "[pipeline]") {
+    mock_output device;
+    hh::shell::output_sink sink{device};
+    cmd_ostream out{sink};
+    hh::shell::pipeline<3, 8> pipeline;
+
+    std::string_view repeatArgs[] = {"repeat", "ab", "100"};
+    std::string_view args[] = {"cmd"};
+    pipeline_stage stages[] = {{&repeat_cmd, repeatArgs}, {&upper_cmd, args}, {&count_cmd, args}};
+
+    REQUIRE(pipeline.start(stages, out));
+    CHECK_FALSE(pipeline.running());
+    CHECK(device.written == "200");
+    CHECK(pipeline.result() == 200);
+}
+
+TEST_CASE("each stage transforms the output of the stage before it", "[pipeline]") {
+    mock_output device;
+    hh::shell::output_sink sink{device};
+    cmd_ostream out{sink};
+    hh::shell::pipeline<3, 4> pipeline;
+
+    std::string_view repeatArgs[] = {"repeat", "xy", "20"};
+    std::string_view headArgs[] = {"head", "5"};
+    std::string_view args[] = {"upper"};
+    pipeline_stage stages[] = {{&repeat_cmd, repeatArgs}, {&upper_cmd, args}, {&head_cmd, headArgs}};
+
+    REQUIRE(pipeline.start(stages, out));
+    CHECK_FALSE(pipeline.running());
+    CHECK(device.written == "XYXYX");
+    CHECK(pipeline.result() == 2);
+}
+
+TEST_CASE("readers wait for their writers to finish before their input ends", "[pipeline]") {
+    mock_output device;
+    hh::shell::output_sink sink{device};
+    cmd_ostream out{sink};
+    hh::shell::pipeline<2, 8> pipeline;
+
+    std::string_view args[] = {"cmd"};
+    pipeline_stage stages[] = {{&sleepy_cmd, args}, {&count_cmd, args}};
+
+    REQUIRE(pipeline.start(stages, out));
+    CHECK(pipeline.running());
+    CHECK(device.written.empty());
+
+    pipeline.tick();
+    CHECK_FALSE(pipeline.running());
+    CHECK(device.written == "6");
+}
+
+namespace {
+    // Writes more than fits in the pipe, waiting for space between each chunk
+    command_task chunked(command::argv_type, cmd_ostream &out) {
+        for (char ch = 'a'; ch < 'd'; ++ch) {
+            out << ch << ch << ch << ch;
+            co_await hh::shell::tx_ready{};
+        }
+        co_return 0;
+    }
+
+    // Does not read its input until it has slept
+    command_task late_upper(command::argv_type, cmd_ostream &out) {
+        co_await hh::shell::sleep_for{1};
+        while (true) {
+            int ch = co_await hh::shell::next_char{};
+            if (ch == hh::shell::end_of_input) { break; }
+            out << static_cast<char>(std::toupper(ch));
+        }
+        co_return 0;
+    }
+
+    constexpr command chunked_cmd{.cmd_name = "chunked", .help_message = "", .execute_async = chunked};
+    constexpr command late_upper_cmd{.cmd_name = "late", .help_message = "", .execute_async = late_upper};
+}// namespace
+
+TEST_CASE("writers waiting for tx_ready are resumed once their pipe is emptied", "[pipeline]") {
+    mock_output device;
+    hh::shell::output_sink sink{device};
+    cmd_ostream out{sink};
+    hh::shell::pipeline<2, 4> pipeline;
+
+    std::string_view args[] = {"cmd"};
+    pipeline_stage stages[] = {{&chunked_cmd, args}, {&late_upper_cmd, args}};
+    REQUIRE(pipeline.start(stages, out));
+
+    // The pipe is full and its reader is not waiting, so the writer keeps waiting
+    pipeline.tx_ready();
+    CHECK(pipeline.running());
+    CHECK(device.written.empty());
+
+    pipeline.tick();
+    CHECK(device.written == "AAAABBBBCCCC");
+    CHECK_FALSE(pipeline.running());
+}
+
+TEST_CASE("pipelines are not started without enough coroutine frames", "[pipeline]") {
+    mock_output device;
+    hh::shell::output_sink sink{device};
+    cmd_ostream out{sink};
+    hh::shell::pipeline<hh::shell::default_max_command_frames + 1, 8> pipeline;
+
+    std::string_view args[] = {"sleepy"};
+    pipeline_stage stages[hh::shell::default_max_command_frames + 1];
+    for (auto &stage : stages) { stage = {&sleepy_cmd, args}; }
+
+    CHECK_FALSE(pipeline.start(stages, out));
+    CHECK_FALSE(pipeline.running());
+
+    // The frames of the stages that had started were freed
+    pipeline_stage one[] = {{&sleepy_cmd, args}};
+    CHECK(pipeline.start(one, out));
+    pipeline.cancel();
+}
+
+namespace {
+    struct fake_timer {
+        static inline std::uint32_t ticks = 0;
+        static std::uint32_t now() { return ticks; }
+    };
+
+    // Takes 10 ticks of its own, and feeds its reader which takes 1 tick per char
+    int slow_writer(command::argv_type, cmd_ostream &out) {
+        fake_timer::ticks += 10;
+        out << "abc";
+        out.flush();
+        return 0;
+    }
+
+    command_task slow_reader(command::argv_type, cmd_ostream &) {
+        while (true) {
+            int ch = co_await hh::shell::next_char{};
+            if (ch == hh::shell::end_of_input) { break; }
+            fake_timer::ticks += 1;
+        }
+        co_return 0;
+    }
+
+    constexpr hh::shell::command_table timed_commands{{
+            {slow_writer, "writer", ""},
+            {.cmd_name = "reader", .help_message = "", .execute_async = slow_reader},
+    }};
+}// namespace
+
+TEST_CASE("each stage is timed without the stages it fed", "[pipeline][command_stats]") {
+    mock_output device;
+    hh::shell::output_sink sink{device};
+    cmd_ostream out{sink};
+    hh::shell::pipeline<2, 8, fake_timer> pipeline;
+    hh::shell::command_stats stats[2];
+    pipeline.set_stats(timed_commands, stats);
+
+    std::string_view args[] = {"cmd"};
+    const auto *commands = timed_commands.begin();
+    pipeline_stage stages[] = {{&commands[0], args}, {&commands[1], args}};
+    REQUIRE(pipeline.start(stages, out));
+
+    CHECK(stats[0].calls == 1);
+    CHECK(stats[0].max_ticks == 10);
+    // Started, then resumed for each char and the end of input, and recorded once as it finished
+    CHECK(stats[1].calls == 1);
+    CHECK(stats[1].max_ticks == 3);
+}
@@ -0,0 +1,130 @@
+/// \file test_ring_buffer.cpp
+/// \brief Tests for fixed capacity FIFO queues
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <hh/ring_buffer.hpp>
+#include <string_view>
+#include <thread>
+
+using hh::container::ring_buffer;
+
+TEST_CASE("ring buffers pop elements in the order they were pushed", "[ring_buffer]") {
+    ring_buffer<int, 3> ring;
+    CHECK(ring.empty());
+
+    CHECK(ring.push(1));
+    CHECK(ring.push(2));
+    CHECK(ring.push(3));
+    CHECK(ring.full());
+    CHECK_FALSE(ring.push(4));
+
+    CHECK(ring.front() == 1);
+    CHECK(ring.pop() == 1);
+    CHECK(ring.push(4));
+    CHECK(ring.pop() == 2);
+    CHECK(ring.pop() == 3);
+    CHECK(ring.pop() == 4);
+    CHECK(ring.empty());
+}
+
+TEST_CASE("ring buffers wrap around their storage", "[ring_buffer]") {
+    ring_buffer<char, 4> ring;
+    for (int i = 0; i < 10; ++i) {
+        CAPTURE(i);
+        CHECK(ring.push(static_cast<char>('a' + i)));
+        CHECK(ring.push(static_cast<char>('A' + i)));
+        CHECK(ring.pop() == 'a' + i);
+        CHECK(ring.pop() == 'A' + i);
+    }
+    CHECK(ring.empty());
+}
+
+TEST_CASE("clearing a ring buffer empties it", "[ring_buffer]") {
+    ring_buffer<int, 2> ring;
+    ring.push(1);
+    ring.push(2);
+    ring.clear();
+    CHECK(ring.empty());
+    CHECK(ring.size() == 0);
+}
+
+TEST_CASE("ring buffers push and pop spans across the end of their storage", "[ring_buffer]") {
+    ring_buffer<char, 5> ring;
+    ring.push('x');
+    ring.push('x');
+    ring.pop();
+    ring.pop();
+
+    std::string_view text{"abcdefg"};
+    CHECK(ring.push(std::span<const char>{text}) == 5);
+    CHECK(ring.full());
+    CHECK(ring[1] == 'b');
+    CHECK(ring.front_segment().size() == 3);
+
+    char out[8]{};
+    CHECK(ring.pop(std::span<char>{out, 4}) == 4);
+    CHECK(std::string_view{out, 4} == "abcd");
+    CHECK(ring.pop(std::span<char>{out}) == 1);
+    CHECK(out[0] == 'e');
+    CHECK(ring.empty());
+}
+
+TEST_CASE("the free space of a ring buffer is written in place and then committed", "[ring_buffer]") {
+    ring_buffer<int, 4> ring;
+    ring.push(1);
+    ring.push(2);
+    ring.pop();
+
+    auto space = ring.back_segment();
+    REQUIRE(space.size() == 2);
+    space[0] = 3;
+    space[1] = 4;
+    ring.commit(2);
+
+    // The free slot at the start is returned once the end has been filled
+    REQUIRE(ring.back_segment().size() == 1);
+    ring.back_segment()[0] = 5;
+    ring.commit(1);
+    CHECK(ring.full());
+    CHECK(ring.back_segment().empty());
+    for (int expected : {2, 3, 4, 5}) { CHECK(ring.pop() == expected); }
+}
+
+TEST_CASE("lock-free ring buffers pass every element from one thread to another in order", "[ring_buffer][spsc]") {
+    ring_buffer<std::uint32_t, 7, hh::container::ring_sync::spsc> ring;
+    constexpr std::uint32_t count = 20000;
+
+    std::thread producer{[&] {
+        std::uint32_t values[3];
+        for (std::uint32_t next = 0; next < count;) {
+            // Alternate single and bulk pushes
+            if (next % 2 == 0) {
+                if (ring.push(next)) {
+                    ++next;
+                } else {
+                    std::this_thread::yield();
+                }
+                continue;
+            }
+            auto n = std::min<std::uint32_t>(3, count - next);
+            for (std::uint32_t i = 0; i < n; ++i) { values[i] = next + i; }
+            auto pushed = static_cast<std::uint32_t>(ring.push(std::span<const std::uint32_t>{values, n}));
+            if (pushed == 0) { std::this_thread::yield(); }
+            next += pushed;
+        }
+    }};
+
+    std::uint32_t expected = 0;
+    bool ordered = true;
+    while (expected < count) {
+        std::uint32_t values[4];
+        auto n = ring.pop(std::span<std::uint32_t>{values});
+        if (n == 0) { std::this_thread::yield(); }
+        for (std::size_t i = 0; i < n; ++i) { ordered = ordered && values[i] == expected++; }
+    }
+    producer.join();
+    CHECK(ordered);
+    CHECK(ring.empty());
+}
@@ -3,15 +3,19 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <hh/serial_queue.hpp>
 #include <hh/shell.hpp>
 #include <sstream>
+#include <vector>
 
 using namespace std::string_literals;
 
 struct mock_serial {
     std::stringstream istream{};
     std::stringstream ostream{};
+    std::size_t numWrites{0};
     void write(const char *s, std::size_t count) {
+        ++numWrites;
         ostream.write(s, count);
     }
     void flush() {
@@ -22,6 +26,14 @@ struct mock_serial {
     }
 };
 
+struct mock_bulk_serial : public mock_serial {
+    std::size_t numReads{0};
+    std::size_t read(char *s, std::size_t count) {
+        ++numReads;
+        return istream.readsome(s, count);
+    }
+};
+
 using shell_t = hh::shell::shell<mock_serial, 10, 64>;
 
 struct shell_test_t : public shell_t {
@@ -42,6 +54,46 @@ TEST_CASE("inputted alpha numeric chars are echoed to serial output", "[shell][e
     CHECK(shell.current_line() == str);
 }
 
+TEST_CASE("output produced while processing input is written to the device in a single write", "[shell][tx]") {
+    mock_serial serial;
+    shell_test_t shell{serial};
+    std::string str{"hello\x1b[1D\b world"};
+
+    serial.istream << str;
+    shell.notify();
+
+    CHECK(serial.numWrites == 1);
+    CHECK(shell.current_line() == std::string{"hel worldo"});
+}
+
+TEST_CASE("output larger than the tx buffer is written each time the buffer fills", "[shell][tx]") {
+    mock_serial serial;
+    hh::shell::shell<mock_serial, 10, 128> shell{serial};
+    std::string str(100, 'a');
+
+    serial.istream << str;
+    shell.notify_rx();
+
+    CHECK(serial.ostream.str() == str);
+    CHECK(serial.numWrites == 2);
+}
+
+TEST_CASE("devices with bulk reads are read a chunk at a time", "[shell][rx]") {
+    static_assert(hh::shell::serial_bulk_in_device<mock_bulk_serial>);
+    static_assert(!hh::shell::serial_bulk_in_device<mock_serial>);
+
+    mock_bulk_serial serial;
+    hh::shell::shell<mock_bulk_serial, 10, 64> shell{serial};
+    std::string str{"a line that is longer than one rx chunk"};
+
+    serial.istream << str;
+    shell.notify_rx();
+
+    CHECK(serial.ostream.str() == str);
+    CHECK(shell.current_line() == str);
+    CHECK(serial.numReads == 3);
+}
+
 TEST_CASE("newline char on non empty line outputs NL-CR and clears current line", "[shell]") {
     mock_serial serial;
     shell_test_t shell{serial};
@@ -50,55 +102,286 @@ TEST_CASE("newline char on non empty line outputs NL-CR and clears current line"
     serial.istream << str;
     shell.notify();
 
-    CHECK(serial.ostream.str() == "hello world 42!\n\r>");
+    CHECK(serial.ostream.str() == "hello world 42!\n\runknown command: hello\n\r>");
     CHECK(shell.current_line() == std::string{""});
 }
 
-TEST_CASE("backspace on non empty line deletes last char", "[shell]") {
+namespace {
+    std::vector<std::string> lastArgs{};
+    int lastCmd{0};
+
+    int cmd_a(hh::shell::command::argv_type argv, hh::shell::cmd_ostream &) {
+        lastCmd = 1;
+        lastArgs.assign(argv.begin(), argv.end());
+        return 0;
+    }
+
+    int cmd_b(hh::shell::command::argv_type argv, hh::shell::cmd_ostream &out) {
+        lastCmd = 2;
+        lastArgs.assign(argv.begin(), argv.end());
+        out << "b ran with " << argv.size() << " args\n\r";
+        return 0;
+    }
+
+    hh::shell::command_task slow(hh::shell::command::argv_type argv, hh::shell::cmd_ostream &out) {
+        out << "started ";
+        co_await hh::shell::sleep_for{2};
+        out << "waiting ";
+        co_await hh::shell::tx_ready{};
+        auto ch = co_await hh::shell::next_char{};
+        out << argv[1] << static_cast<char>(ch);
+        co_return 0;
+    }
+
+    constexpr const char *cmd_b_keywords[] = {"enable", "disable", nullptr};
+
+    constexpr hh::shell::command_table test_commands{{
+            {cmd_a, "cmd_a", "runs command a"},
+            {cmd_b, "cmd_b", "runs command b", cmd_b_keywords},
+            {cmd_a, "other", "runs command a"},
+            {.cmd_name = "slow", .help_message = "waits", .execute_async = slow},
+    }};
+
+    constexpr hh::shell::completion_trie<test_commands> test_completions{};
+}// namespace
+
+TEST_CASE("submitted lines run the matching command from the command table", "[shell][commands]") {
+    mock_serial serial;
+    shell_test_t shell{serial, test_commands};
+    lastCmd = 0;
+
+    auto [str, expected, args] = GENERATE(
+            std::tuple{"cmd_a\n"s, 1, std::vector{"cmd_a"s}},
+            std::tuple{"cmd_a one  two\n"s, 1, std::vector{"cmd_a"s, "one"s, "two"s}},
+            std::tuple{"  cmd_a 'quoted arg' \"x\\\"y\"\n"s, 1, std::vector{"cmd_a"s, "quoted arg"s, "x\"y"s}});
+
+    CAPTURE(str);
+    serial.istream << str;
+    shell.notify();
+
+    CHECK(lastCmd == expected);
+    CHECK(lastArgs == args);
+    CHECK(serial.ostream.str() == str + "\r>");
+}
+
+TEST_CASE("commands write their output to the shell's serial output", "[shell][commands]") {
+    mock_serial serial;
+    shell_test_t shell{serial, test_commands};
+
+    serial.istream << "cmd_b 1 2\n";
+    shell.notify();
+
+    CHECK(serial.ostream.str() == "cmd_b 1 2\n\rb ran with 3 args\n\r>");
+}
+
+SCENARIO("coroutine commands are resumed by the shell without blocking input", "[shell][commands]") {
+    GIVEN("a running coroutine command") {
+        mock_serial serial;
+        shell_test_t shell{serial, test_commands};
+
+        serial.istream << "slow arg\n";
+        shell.notify();
+        CHECK(serial.ostream.str() == "slow arg\n\rstarted ");
+
+        WHEN("the command is resumed by each thing it waits for") {
+            shell.notify_tick();
+            CHECK(serial.ostream.str() == "slow arg\n\rstarted ");
+            shell.notify_tick();
+            CHECK(serial.ostream.str() == "slow arg\n\rstarted waiting ");
+
+            serial.istream.clear();
+            serial.istream << "x";
+            shell.notify();
+            CHECK(serial.ostream.str() == "slow arg\n\rstarted waiting ");
+
+            shell.notify_tx_ready();
+            serial.istream.clear();
+            serial.istream << "y";
+            shell.notify();
+
+            THEN("the command finishes and a new prompt is shown") {
+                CHECK(serial.ostream.str() == "slow arg\n\rstarted waiting argy>");
+                CHECK(shell.current_line().empty());
+            }
+        }
+
+        WHEN("Ctrl-C is received") {
+            serial.istream.clear();
+            serial.istream << "\x03";
+            shell.notify();
+            shell.notify_tick();
+            shell.notify_tick();
+
+            THEN("the command is cancelled") {
+                CHECK(serial.ostream.str() == "slow arg\n\rstarted ^C\n\r>");
+            }
+        }
+    }
+}
+
+TEST_CASE("Ctrl-C discards the current line", "[shell]") {
     mock_serial serial;
     shell_test_t shell{serial};
-    std::string str{"hello world 42!\b\b\b\b"};
 
+    serial.istream << "abc\x03";
+    shell.notify();
+
+    CHECK(serial.ostream.str() == "abc^C\n\r>");
+    CHECK(shell.current_line().empty());
+}
+
+TEST_CASE("tab completes command names and keywords by sending only the missing chars", "[shell][completion]") {
+    mock_serial serial;
+    shell_test_t shell{serial, test_commands, test_completions};
+
+    auto [typed, line, output] = GENERATE(
+            std::tuple{"o\t"s, "other "s, "other "s},
+            std::tuple{"c\t"s, "cmd_"s, "cmd_"s},
+            std::tuple{"cmd_b d\t"s, "cmd_b disable "s, "cmd_b disable "s},
+            std::tuple{"cmd_a d\t"s, "cmd_a d"s, "\acmd_a d"s},
+            std::tuple{"x\t"s, "x"s, "\ax"s});
+
+    CAPTURE(typed);
+    serial.istream << typed;
+    shell.notify();
+
+    CHECK(shell.current_line() == line);
+    CHECK(serial.ostream.str() == output);
+}
+
+TEST_CASE("completing in the middle of a line inserts the missing chars", "[shell][completion]") {
+    mock_serial serial;
+    shell_test_t shell{serial, test_commands, test_completions};
+
+    serial.istream << "oth arg";
+    shell.notify();
+    serial.istream.clear();
+    serial.istream << "\x1b[4D\t";
+    shell.notify();
+
+    CHECK(shell.current_line() == "other arg"s);
+    CHECK(serial.ostream.str() == "oth arg\b\b\b\b\x1b[2@er");
+}
+
+TEST_CASE("lines that cannot be tokenized do not run a command", "[shell][commands]") {
+    mock_serial serial;
+    shell_test_t shell{serial, test_commands};
+    lastCmd = 0;
+
+    auto [str, expected] = GENERATE(
+            std::tuple{"cmd_a 'open\n"s, "unterminated quote"s},
+            std::tuple{"cmd_a 1 2 3 4 5 6 7 8\n"s, "too many arguments"s});
+
+    CAPTURE(str);
     serial.istream << str;
     shell.notify();
 
+    CHECK(lastCmd == 0);
+    CHECK(serial.ostream.str() == str + "\r" + expected + "\n\r>");
+}
+
+TEST_CASE("empty lines do not run a command", "[shell][commands]") {
+    mock_serial serial;
+    shell_test_t shell{serial, test_commands};
+    lastCmd = 0;
+
+    serial.istream << "   \n";
+    shell.notify();
+
+    CHECK(lastCmd == 0);
+    CHECK(serial.ostream.str() == "   \n\r>");
+}
+
+TEST_CASE("backspace on non empty line deletes last char", "[shell]") {
+    mock_serial serial;
+    shell_test_t shell{serial};
+
+    serial.istream << "hello world 42!";
+    shell.notify();
+    for (int i = 0; i < 4; ++i) {
+        serial.istream.clear();
+        serial.istream << '\b';
+        shell.notify();
+    }
+
     CHECK(serial.ostream.str() == "hello world 42!"
-                                  "\x1b[s\x1b[2K>hello world 42\x1b[u\x1b[1D"
-                                  "\x1b[s\x1b[2K>hello world 4\x1b[u\x1b[1D"
-                                  "\x1b[s\x1b[2K>hello world \x1b[u\x1b[1D"
-                                  "\x1b[s\x1b[2K>hello world\x1b[u\x1b[1D");
+                                  "\b \b"
+                                  "\b \b"
+                                  "\b \b"
+                                  "\b \b");
     CHECK(shell.current_line() == std::string{"hello world"});
 }
 
 TEST_CASE("backspace on empty line has no effect", "[shell]") {
     mock_serial serial;
     shell_test_t shell{serial};
-    std::string str{"hi!\b\b\b\bhi!"};
 
-    serial.istream << str;
-    shell.notify();
+    for (auto str : {"hi!", "\b", "\b", "\b", "\b", "hi!"}) {
+        serial.istream.clear();
+        serial.istream << str;
+        shell.notify();
+    }
 
     CHECK(serial.ostream.str() == "hi!"
-                                  "\x1b[s\x1b[2K>hi\x1b[u\x1b[1D"
-                                  "\x1b[s\x1b[2K>h\x1b[u\x1b[1D"
-                                  "\x1b[s\x1b[2K>\x1b[u\x1b[1D"
+                                  "\b \b"
+                                  "\b \b"
+                                  "\b \b"
                                   "hi!");
     CHECK(shell.current_line() == std::string{"hi!"});
 }
 
-TEST_CASE("left ansi code followed by backspace deletes second to last char", "[shell]") {
+TEST_CASE("edits received in a single burst are drawn once", "[shell]") {
     mock_serial serial;
     shell_test_t shell{serial};
-    std::string str{"hello world 42!\x1b[1D\b"};
+    std::string str{"hello world 42!\b\b\b\b"};
 
     serial.istream << str;
     shell.notify();
 
-    CHECK(serial.ostream.str() == "hello world 42!\x1b[1D"
-                                  "\x1b[s\x1b[2K>hello world 4!\x1b[u\x1b[1D");
+    CHECK(serial.ostream.str() == "hello world");
+    CHECK(shell.current_line() == std::string{"hello world"});
+}
+
+TEST_CASE("left ansi code followed by backspace deletes second to last char", "[shell]") {
+    mock_serial serial;
+    shell_test_t shell{serial};
+
+    serial.istream << "hello world 42!";
+    shell.notify();
+    serial.istream.clear();
+    serial.istream << "\x1b[1D\b";
+    shell.notify();
+
+    CHECK(serial.ostream.str() == "hello world 42!"
+                                  "\b\b\x1b[P");
     CHECK(shell.current_line() == std::string{"hello world 4!"});
 }
 
+TEST_CASE("chars inserted in the middle of a line shift the rest of the line", "[shell]") {
+    mock_serial serial;
+    shell_test_t shell{serial};
+
+    serial.istream << "hello world";
+    shell.notify();
+    serial.istream.clear();
+    serial.istream << "\x1b[6D,";
+    shell.notify();
+
+    CHECK(serial.ostream.str() == "hello world"
+                                  "\x1b[6D\x1b[@,");
+    CHECK(shell.current_line() == std::string{"hello, world"});
+}
+
+TEST_CASE("cursor movement is limited to the current line", "[shell]") {
+    mock_serial serial;
+    shell_test_t shell{serial};
+
+    serial.istream << "abc\x1b[9Dx\x1b[9Cy";
+    shell.notify();
+
+    CHECK(shell.current_line() == std::string{"xabcy"});
+}
+
 SCENARIO("up and down ansi codes allow next a previous commands to be accessed and modified", "[shell][history") {
     GIVEN("A shell with a non empty command history") {
         mock_serial serial;
@@ -125,7 +408,7 @@ SCENARIO("up and down ansi codes allow next a previous commands to be accessed a
             shell.notify();
 
             THEN("the previous command is displayed") {
-                CHECK(serial.ostream.str() == "\x1B[2K>cmd4");
+                CHECK(serial.ostream.str() == "cmd4");
                 CHECK(shell.current_line() == cmd4);
             }
 
@@ -140,7 +423,7 @@ SCENARIO("up and down ansi codes allow next a previous commands to be accessed a
             shell.notify();
 
             THEN("the second to most recent command is displayed") {
-                CHECK(serial.ostream.str() == "\x1B[2K>cmd4\x1B[2K>cmd3");
+                CHECK(serial.ostream.str() == "cmd3");
                 CHECK(shell.current_line() == cmd3);
             }
 
@@ -149,7 +432,7 @@ SCENARIO("up and down ansi codes allow next a previous commands to be accessed a
                 serial.istream << down_code;
                 shell.notify();
                 THEN("the previous command is displayed") {
-                    CHECK(serial.ostream.str() == "\x1B[2K>cmd4\x1B[2K>cmd3\x1B[2K>cmd4");
+                    CHECK(serial.ostream.str() == "cmd3\b4");
                     CHECK(shell.current_line() == cmd4);
                 }
             }
@@ -160,7 +443,7 @@ SCENARIO("up and down ansi codes allow next a previous commands to be accessed a
             shell.notify();
 
             THEN("the oldest stored command is displayed") {
-                CHECK(serial.ostream.str() == "\x1B[2K>cmd4\x1B[2K>cmd3\x1B[2K>cmd2\x1B[2K>cmd1");
+                CHECK(serial.ostream.str() == "cmd1");
                 CHECK(shell.current_line() == cmd1);
             }
 
@@ -170,7 +453,7 @@ SCENARIO("up and down ansi codes allow next a previous commands to be accessed a
                 shell.notify();
 
                 THEN("the second oldest stored command is displayed") {
-                    CHECK(serial.ostream.str() == "\x1B[2K>cmd4\x1B[2K>cmd3\x1B[2K>cmd2\x1B[2K>cmd1\x1B[2K>cmd2");
+                    CHECK(serial.ostream.str() == "cmd1\b2");
                     CHECK(shell.current_line() == cmd2);
                 }
             }
@@ -188,7 +471,7 @@ SCENARIO("up and down ansi codes allow next a previous commands to be accessed a
                 serial.istream << up_code;
                 shell.notify();
                 THEN("the previous command is displayed") {
-                    CHECK(serial.ostream.str() == "\x1B[2K>cmd4");
+                    CHECK(serial.ostream.str() == "cmd4");
                     CHECK(shell.current_line() == cmd4);
                 }
             }
@@ -197,4 +480,1042 @@ SCENARIO("up and down ansi codes allow next a previous commands to be accessed a
         // todo modification and command entered
         // todo repeated command
     }
-}
\ No newline at end of file
+}
+
+namespace {
+    // Stands in for a mutex shared by every session writing to the same device
+    struct shared_lock {
+        static inline int locks = 0;
+        static inline bool held = false;
+        void lock() {
+            CHECK_FALSE(held);
+            held = true;
+            ++locks;
+        }
+        void unlock() { held = false; }
+    };
+
+    struct locked_config : hh::shell::shell_config {
+        using lock_type = shared_lock;
+    };
+
+    struct shared_serial : public mock_serial {
+        std::size_t unlockedWrites{0};
+        void write(const char *s, std::size_t count) {
+            if (!shared_lock::held) { ++unlockedWrites; }
+            mock_serial::write(s, count);
+        }
+    };
+}// namespace
+
+TEST_CASE("sessions sharing a command table write each burst of output under their lock", "[shell][lock]") {
+    using locked_shell = hh::shell::shell<shared_serial, 10, 64, locked_config>;
+    shared_serial uart;
+    shared_serial usb;
+    locked_shell uartShell{uart, test_commands};
+    locked_shell usbShell{usb, test_commands};
+    shared_lock::locks = 0;
+
+    uart.istream << "cmd_b 1\n";
+    usb.istream << "cmd_b 1 2\n";
+    uartShell.notify_rx();
+    usbShell.notify_rx();
+
+    CHECK(uart.ostream.str() == "cmd_b 1\n\rb ran with 2 args\n\r>");
+    CHECK(usb.ostream.str() == "cmd_b 1 2\n\rb ran with 3 args\n\r>");
+    CHECK(shared_lock::locks == 2);
+    CHECK(uart.unlockedWrites + usb.unlockedWrites == 0);
+
+    // Output larger than the tx buffer is written in parts, all under the one lock
+    uart.istream.clear();
+    uart.istream << "cmd_b " << std::string(50, 'x') << " " << std::string(50, 'y') << "\n";
+    uartShell.notify_rx();
+    CHECK(shared_lock::locks == 3);
+    CHECK(uart.unlockedWrites == 0);
+    CHECK_FALSE(shared_lock::held);
+}
+
+SCENARIO("batch mode runs lines without echo or prompts and reports their status", "[shell][batch]") {
+    GIVEN("a shell switched to batch mode by an escape sequence") {
+        mock_serial serial;
+        shell_test_t shell{serial, test_commands};
+        serial.istream << "\x1b[b";
+        shell.notify();
+        CHECK(shell.batch_mode());
+        CHECK(serial.ostream.str().empty());
+
+        WHEN("lines are received") {
+            serial.istream.clear();
+            serial.istream << "cmd_b 1\r\n\r\nnope\ncmd_a\n\x1b[A\n";
+            shell.notify();
+
+            THEN("only command output and a status per line is sent") {
+                CHECK(serial.ostream.str() == "b ran with 2 args\n\r=0\n\r"
+                                              "=0\n\r"
+                                              "unknown command: nope\n\r=-1\n\r"
+                                              "=0\n\r"
+                                              "unknown command: \x1b[A\n\r=-1\n\r");
+            }
+        }
+
+        WHEN("EOT is received") {
+            serial.istream.clear();
+            serial.istream << "cmd_a\x04" << "ab";
+            shell.notify();
+
+            THEN("the shell is interactive again") {
+                CHECK_FALSE(shell.batch_mode());
+                CHECK(serial.ostream.str() == ">ab");
+            }
+        }
+    }
+}
+
+TEST_CASE("batch lines too long for the line are not run, and blank lines report a status", "[shell][batch]") {
+    mock_serial serial;
+    shell_test_t shell{serial, test_commands};
+    shell.set_batch_mode(true);
+    lastCmd = 0;
+
+    serial.istream << "#4 cmd_a " << std::string(64, 'x') << "\n \t\r\n#5\t\n";
+    shell.notify_rx();
+
+    CHECK(lastCmd == 0);
+    CHECK(serial.ostream.str() == "line too long\n\r#4=-2\n\r=0\n\r#5=0\n\r");
+}
+
+TEST_CASE("batch mode holds back lines while a coroutine command runs", "[shell][batch]") {
+    mock_bulk_serial serial;
+    hh::shell::shell<mock_bulk_serial, 10, 64> shell{serial, test_commands};
+    shell.set_batch_mode(true);
+
+    serial.istream << "slow arg\nz\ncmd_b\n";
+    shell.notify_rx();
+    CHECK(serial.ostream.str() == "started ");
+
+    shell.notify_tick();
+    shell.notify_tick();
+    shell.notify_tx_ready();
+    CHECK(serial.ostream.str() == "started waiting argz=0\n\rb ran with 1 args\n\r=0\n\r");
+}
+
+namespace {
+    struct batch_config : hh::shell::shell_config {
+        static constexpr bool batch_mode = true;
+    };
+}// namespace
+
+TEST_CASE("shells configured for batch mode start in batch mode", "[shell][batch]") {
+    mock_serial serial;
+    hh::shell::shell<mock_serial, 10, 64, batch_config> shell{serial, test_commands};
+
+    serial.istream << "cmd_a\n";
+    shell.notify_rx();
+    shell.notify_connected();
+
+    CHECK(shell.batch_mode());
+    CHECK(serial.ostream.str() == "=0\n\r");
+}
+
+TEST_CASE("connecting turns on bracketed paste in the terminal", "[shell][paste]") {
+    mock_serial serial;
+    shell_test_t shell{serial};
+
+    shell.connect();
+
+    CHECK(serial.ostream.str() == "\x1b[?2004h\n\r\n\r>");
+}
+
+TEST_CASE("pasted text is copied into the line and echoed in one write", "[shell][paste]") {
+    mock_bulk_serial serial;
+    hh::shell::shell<mock_bulk_serial, 10, 64> shell{serial, test_commands, test_completions};
+
+    serial.istream << "\x1b[200~cmd_b\tx\b y\ncmd_b\x1b[201~\t";
+    shell.notify_rx();
+
+    // Pasted tabs become spaces and other control chars are dropped, so the line matches what is shown
+    CHECK(serial.numWrites == 1);
+    CHECK(lastArgs == std::vector{"cmd_b"s, "x"s, "y"s});
+    CHECK(serial.ostream.str() == "cmd_b x y\n\rb ran with 3 args\n\r>cmd_b ");
+    CHECK(shell.current_line() == "cmd_b ");
+}
+
+TEST_CASE("paste markers with params that overflow a byte are ignored", "[shell][paste]") {
+    mock_serial serial;
+    hh::shell::shell<mock_serial, 10, 64> shell{serial, test_commands, test_completions};
+
+    // 456 would wrap round to the 200 that starts a paste
+    serial.istream << "\x1b[456~cmd_\t";
+    shell.notify_rx();
+
+    CHECK(shell.current_line() == "cmd_");
+}
+
+TEST_CASE("bracketed paste is turned off when the terminal is not read by a person", "[shell][paste]") {
+    mock_serial serial;
+    shell_test_t shell{serial, test_commands};
+    shell.connect();
+    serial.ostream.str("");
+
+    SECTION("in batch mode") {
+        serial.istream << "\x1b[b";
+        shell.notify();
+        CHECK(serial.ostream.str() == "\x1b[?2004l");
+
+        serial.istream.clear();
+        serial.istream << "\x04";
+        shell.notify();
+        CHECK(serial.ostream.str() == "\x1b[?2004l\x1b[?2004h>");
+    }
+
+    SECTION("once disconnected") {
+        shell.notify_disconnected();
+        CHECK(serial.ostream.str() == "\x1b[?2004l");
+        shell.notify_disconnected();
+        CHECK(serial.ostream.str() == "\x1b[?2004l");
+    }
+}
+
+namespace {
+    struct piped_config : hh::shell::shell_config {
+        static constexpr std::size_t max_pipeline_stages = 4;
+    };
+    using piped_shell = hh::shell::shell<mock_serial, 10, 64, piped_config>;
+}// namespace
+
+TEST_CASE("commands separated by | are run as a pipeline", "[shell][pipeline]") {
+    mock_serial serial;
+    piped_shell shell{serial, test_commands};
+
+    serial.istream << "cmd_b 1 2 | slow arg\n";
+    shell.notify_rx();
+    shell.notify_tick();
+    shell.notify_tick();
+    shell.notify_tx_ready();
+
+    // slow reads the first char of cmd_b's output after waiting
+    CHECK(serial.ostream.str() == "cmd_b 1 2 | slow arg\n\rstarted waiting argb>");
+}
+
+TEST_CASE("a quoted | is passed to the command as an argument", "[shell][pipeline]") {
+    mock_serial serial;
+    shell_test_t shell{serial, test_commands};
+
+    serial.istream << "cmd_b '|' \\| x\n";
+    shell.notify();
+
+    CHECK(lastArgs == std::vector<std::string>{"cmd_b", "|", "|", "x"});
+}
+
+TEST_CASE("pipelines with an empty stage are not run", "[shell][pipeline]") {
+    mock_serial serial;
+    piped_shell shell{serial, test_commands};
+    lastCmd = 0;
+
+    serial.istream << "cmd_a | | cmd_a\n";
+    shell.notify_rx();
+
+    CHECK(lastCmd == 0);
+    CHECK(serial.ostream.str() == "cmd_a | | cmd_a\n\rempty pipeline stage\n\r>");
+}
+
+namespace {
+    struct large_pool_config : piped_config {
+        static constexpr std::size_t max_command_frames = 3;
+    };
+}// namespace
+
+TEST_CASE("shells with their own frame settings take frames from their own pool", "[shell][pipeline]") {
+    {
+        mock_serial serial;
+        piped_shell shell{serial, test_commands};
+        serial.istream << "slow a | slow b | slow c\n";
+        shell.notify_rx();
+        CHECK(serial.ostream.str().find("no free command frames") != std::string::npos);
+    }
+
+    // The default pool is detached with the last shell using it
+    mock_serial serial;
+    hh::shell::shell<mock_serial, 10, 64, large_pool_config> shell{serial, test_commands};
+    serial.istream << "slow a | slow b | slow c\n";
+    shell.notify_rx();
+    CHECK(serial.ostream.str().find("no free command frames") == std::string::npos);
+    CHECK(serial.ostream.str().find("started") != std::string::npos);
+}
+
+TEST_CASE("commands cannot be piped when pipelines are disabled", "[shell][pipeline]") {
+    mock_serial serial;
+    shell_test_t shell{serial, test_commands};
+    lastCmd = 0;
+
+    serial.istream << "cmd_a | cmd_a\n";
+    shell.notify();
+
+    CHECK(lastCmd == 0);
+    CHECK(serial.ostream.str() == "cmd_a | cmd_a\n\rtoo many pipeline stages\n\r>");
+}
+
+namespace {
+    struct tick_timer {
+        static inline std::uint32_t ticks = 0;
+        static std::uint32_t now() { return ticks += 3; }
+    };
+
+    struct timed_config : hh::shell::shell_config {
+        using command_timer = tick_timer;
+    };
+}// namespace
+
+TEST_CASE("the stats command prints the run times of commands", "[shell][command_stats]") {
+    mock_serial serial;
+    hh::shell::shell<mock_serial, 10, 64, timed_config> shell{serial, test_commands};
+    hh::shell::command_stats stats[std::size(test_commands)];
+    shell.set_command_stats(stats);
+
+    serial.istream << "other\nother\nstats\n";
+    shell.notify_rx();
+
+    auto other = hh::shell::command_set{test_commands}.find("other") - test_commands.begin();
+    CHECK(stats[other].calls == 2);
+    CHECK(stats[other].max_ticks == 3);
+    CHECK(serial.ostream.str().ends_with("stats\n\rcommand calls max histogram\n\r"
+                                         "other 2 3 0 0 2 0 0 0 0 0 0 0 0 0\n\r>"));
+
+    serial.ostream.str("");
+    serial.istream.clear();
+    serial.istream << "stats reset\n";
+    shell.notify_rx();
+    CHECK(stats[other].calls == 0);
+}
+
+TEST_CASE("built in commands cannot be piped", "[shell][command_stats]") {
+    mock_serial serial;
+    hh::shell::shell<mock_serial, 10, 64, timed_config> shell{serial, test_commands};
+    hh::shell::command_stats stats[std::size(test_commands)];
+    shell.set_command_stats(stats);
+    shell.set_batch_mode(true);
+
+    serial.istream << "stats | cmd_a\n";
+    shell.notify_rx();
+    CHECK(serial.ostream.str() == "stats: built in commands cannot be piped\n\r=-2\n\r");
+}
+
+namespace {
+    struct counted_config : hh::shell::shell_config {
+        static constexpr bool io_counters = true;
+    };
+}// namespace
+
+TEST_CASE("io counters count chars in, out and spent redrawing the line", "[shell][io_counters]") {
+    mock_serial serial;
+    hh::shell::shell<mock_serial, 10, 64, counted_config> shell{serial, test_commands};
+
+    // A malformed escape sequence is dropped, and does not swallow the chars after it
+    serial.istream << "ab\x1b[D\x1bxy";
+    shell.notify_rx();
+
+    CHECK(shell.current_line() == "ayb");
+    CHECK(serial.ostream.str() == "ayb\b");
+    const auto &counters = shell.io_stats();
+    CHECK(counters.rx_bytes == 8);
+    CHECK(counters.max_rx_burst == 8);
+    CHECK(counters.tx_bytes == 4);
+    CHECK(counters.ansi_parsed == 1);
+    CHECK(counters.ansi_rejected == 1);
+    CHECK(counters.echo_bytes == 3);
+    CHECK(counters.redraw_bytes == 1);
+
+    serial.istream.clear();
+    serial.istream << "\niostat\n";
+    shell.notify_rx();
+    CHECK(counters.max_rx_burst == 8);
+    auto output = serial.ostream.str();
+    auto stats = output.substr(output.find("iostat\n\r") + 8);
+    CHECK(stats.starts_with("rx 16\n\rtx "));
+    CHECK(stats.ends_with("\n\rmax rx burst 8\n\ransi parsed 1\n\ransi rejected 1\n\recho 9\n\rredraw 1\n\r>"));
+}
+
+namespace {
+    struct logged_config : hh::shell::shell_config {
+        static constexpr std::size_t log_buffer_size = 128;
+    };
+    using logged_shell = hh::shell::shell<mock_serial, 10, 64, logged_config>;
+}// namespace
+
+TEST_CASE("log lines are printed above the prompt and the line is redrawn once", "[shell][log]") {
+    mock_serial serial;
+    logged_shell shell{serial, test_commands};
+    serial.istream << "cmd_a x\x1b[D";
+    shell.notify_rx();
+    serial.ostream.str("");
+    serial.numWrites = 0;
+
+    CHECK(shell.log("temp 21"));
+    CHECK(shell.log("temp 22"));
+    shell.notify_tick();
+
+    CHECK(serial.numWrites == 1);
+    CHECK(serial.ostream.str() == "\r\x1b[2Ktemp 21\n\rtemp 22\n\r>cmd_a x\b");
+    CHECK(shell.current_line() == "cmd_a x");
+
+    // Typing continues where the cursor was left
+    serial.istream.clear();
+    serial.istream << "y";
+    shell.notify_rx();
+    CHECK(shell.current_line() == "cmd_a yx");
+}
+
+TEST_CASE("log lines are held while a command runs", "[shell][log]") {
+    mock_serial serial;
+    logged_shell shell{serial, test_commands};
+    serial.istream << "slow arg\n";
+    shell.notify_rx();
+
+    shell.log("event");
+    shell.notify_log();
+    CHECK(serial.ostream.str() == "slow arg\n\rstarted ");
+
+    shell.notify_tick();
+    shell.notify_tick();
+    shell.notify_tx_ready();
+    serial.istream.clear();
+    serial.istream << "z";
+    shell.notify_rx();
+    CHECK(serial.ostream.str() == "slow arg\n\rstarted waiting argz>\r\x1b[2Kevent\n\r>");
+}
+
+TEST_CASE("log lines that do not fit in the queue are dropped", "[shell][log]") {
+    mock_serial serial;
+    logged_shell shell{serial};
+
+    std::string line(logged_config::log_buffer_size, 'x');
+    CHECK_FALSE(shell.log(line));
+    line.pop_back();
+    CHECK(shell.log(line));
+    CHECK_FALSE(shell.log(""));
+}
+
+TEST_CASE("log lines are dropped without a log buffer", "[shell][log]") {
+    mock_serial serial;
+    shell_test_t shell{serial};
+
+    CHECK_FALSE(shell.log("event"));
+    shell.notify_log();
+    CHECK(serial.ostream.str().empty());
+}
+
+namespace {
+    struct mock_nonblocking_serial : public mock_serial {
+        std::size_t space{1000};
+        std::size_t try_write(const char *s, std::size_t count) {
+            auto n = std::min(count, space);
+            space -= n;
+            write(s, n);
+            return n;
+        }
+    };
+
+    struct flow_control_config : hh::shell::shell_config {
+        static constexpr std::size_t tx_ring_size = 32;
+        static constexpr bool xon_xoff = true;
+    };
+}// namespace
+
+TEST_CASE("XOFF holds output until XON, without reaching the line", "[shell][flow_control]") {
+    mock_nonblocking_serial serial;
+    hh::shell::shell<mock_nonblocking_serial, 10, 64, flow_control_config> shell{serial, test_commands};
+
+    serial.istream << "ab";
+    shell.notify_rx();
+    CHECK(serial.ostream.str() == "ab");
+
+    serial.istream.clear();
+    serial.istream << "\x13"
+                   << "cd";
+    shell.notify_rx();
+    CHECK(serial.ostream.str() == "ab");
+    CHECK(shell.current_line() == "abcd");
+
+    serial.istream.clear();
+    serial.istream << "\x11";
+    shell.notify_rx();
+    CHECK(serial.ostream.str() == "abcd");
+    CHECK(shell.current_line() == "abcd");
+}
+
+TEST_CASE("output a device cannot accept yet is sent when it is ready", "[shell][flow_control]") {
+    mock_nonblocking_serial serial;
+    serial.space = 3;
+    hh::shell::shell<mock_nonblocking_serial, 10, 64, flow_control_config> shell{serial, test_commands};
+
+    serial.istream << "hello";
+    shell.notify_rx();
+    CHECK(serial.ostream.str() == "hel");
+
+    serial.space = 100;
+    shell.notify_tx_ready();
+    CHECK(serial.ostream.str() == "hello");
+}
+
+TEST_CASE("a line whose echo did not fit in the ring is drawn again once there is space", "[shell][flow_control]") {
+    mock_nonblocking_serial serial;
+    hh::shell::shell<mock_nonblocking_serial, 10, 64, flow_control_config> shell{serial, test_commands};
+    const std::string typed(40, 'a');
+
+    // The ring holds 32 chars, so the rest of the echo is lost while output is paused
+    serial.istream << "\x13" << typed;
+    shell.notify_rx();
+    serial.istream.clear();
+    serial.istream << "\x11";
+    shell.notify_rx();
+    CHECK(serial.ostream.str() == typed.substr(0, 32));
+
+    shell.notify_tx_ready();
+    CHECK(serial.ostream.str() == typed.substr(0, 32) + "\r\x1b[2K>" + typed);
+    CHECK(shell.current_line() == typed);
+}
+
+TEST_CASE("commands waiting for tx_ready are not resumed while output is paused", "[shell][flow_control]") {
+    mock_nonblocking_serial serial;
+    hh::shell::shell<mock_nonblocking_serial, 10, 64, flow_control_config> shell{serial, test_commands};
+    serial.istream << "slow arg\n";
+    shell.notify_rx();
+    shell.notify_tick();
+    shell.notify_tick();
+    CHECK(serial.ostream.str() == "slow arg\n\rstarted waiting ");
+
+    serial.istream.clear();
+    serial.istream << "\x13";
+    shell.notify_rx();
+    shell.notify_tx_ready();
+    serial.istream.clear();
+    serial.istream << "x";
+    shell.notify_rx();
+    CHECK(serial.ostream.str() == "slow arg\n\rstarted waiting ");
+
+    serial.istream.clear();
+    serial.istream << "\x11";
+    shell.notify_rx();
+    shell.notify_tx_ready();
+    serial.istream.clear();
+    serial.istream << "y";
+    shell.notify_rx();
+    CHECK(serial.ostream.str() == "slow arg\n\rstarted waiting argy>");
+}
+
+namespace {
+    struct framed_config : hh::shell::shell_config {
+        static constexpr std::size_t frame_size = 64;
+    };
+
+    using framed_shell_t = hh::shell::shell<mock_serial, 10, 64, framed_config>;
+
+    struct frame_output {
+        std::string data{};
+        void write(const char *s, std::size_t count) { data.append(s, count); }
+    };
+
+    std::string request_frame(std::uint8_t seq, std::initializer_list<std::string> args) {
+        std::string packet(1, static_cast<char>(seq));
+        for (const auto &arg : args) { packet += static_cast<char>(arg.size()) + arg; }
+        auto crc = hh::shell::crc16(packet);
+        packet += static_cast<char>(crc & 0xff);
+        packet += static_cast<char>(crc >> 8);
+        frame_output out;
+        hh::shell::cobs_encode(out, packet);
+        return '\0' + out.data + '\0';
+    }
+
+    struct response {
+        std::uint8_t seq{};
+        int status{};
+        std::string output{};
+    };
+
+    /// Decodes the frames in the output, skipping anything between them
+    std::vector<response> responses(const std::string &output) {
+        std::vector<response> result;
+        std::size_t start = output.find('\0');
+        while (start != std::string::npos) {
+            auto end = output.find('\0', start + 1);
+            REQUIRE(end != std::string::npos);
+            std::string frame = output.substr(start + 1, end - start - 1);
+            std::size_t size = 0;
+            REQUIRE(hh::shell::cobs_decode(frame, size));
+            frame.resize(size);
+            REQUIRE(hh::shell::check_packet(frame));
+            std::uint32_t status = 0;
+            for (std::size_t i = 0; i < 4; ++i) { status |= std::uint32_t(std::uint8_t(frame[1 + i])) << (8 * i); }
+            result.push_back({std::uint8_t(frame[0]), static_cast<int>(status), frame.substr(5, size - 7)});
+            start = output.find('\0', end + 1);
+        }
+        return result;
+    }
+}// namespace
+
+TEST_CASE("framed requests run commands and are answered with their status and output", "[shell][framing]") {
+    mock_serial serial;
+    framed_shell_t shell{serial, test_commands};
+    serial.istream << "cm";
+    shell.notify_rx();
+    serial.ostream.str("");
+    serial.istream.clear();
+    serial.istream << request_frame(7, {"cmd_b", "on"});
+    shell.notify_rx();
+
+    auto output = serial.ostream.str();
+    CHECK(output.starts_with("\0"s));
+    CHECK(output.ends_with("\0"s));
+    auto replies = responses(output);
+    REQUIRE(replies.size() == 1);
+    CHECK(replies[0].seq == 7);
+    CHECK(replies[0].status == 0);
+    CHECK(replies[0].output == "b ran with 2 args\n\r");
+    CHECK(lastArgs == std::vector<std::string>{"cmd_b", "on"});
+
+    // The line being typed is left alone
+    CHECK(shell.current_line() == "cm");
+}
+
+TEST_CASE("framed requests that cannot run a command are answered with a status", "[shell][framing]") {
+    mock_serial serial;
+    framed_shell_t shell{serial, test_commands};
+    serial.istream << request_frame(1, {"nope"}) << request_frame(2, {}) << request_frame(3, {"cmd_a", "a b"});
+    shell.notify_rx();
+
+    auto replies = responses(serial.ostream.str());
+    REQUIRE(replies.size() == 3);
+    CHECK(replies[0].status == hh::shell::status_unknown_command);
+    CHECK(replies[1].status == hh::shell::status_bad_arguments);
+    CHECK(replies[2].status == 0);
+    CHECK(lastArgs == std::vector<std::string>{"cmd_a", "a b"});
+}
+
+TEST_CASE("corrupt frames are dropped without a response", "[shell][framing]") {
+    mock_serial serial;
+    framed_shell_t shell{serial, test_commands};
+    auto frame = request_frame(1, {"cmd_a"});
+    frame[3] ^= 0x20;
+    // Two delimiters in a row start the frame again
+    serial.istream << frame << "\0"s << request_frame(2, {"cmd_a"});
+    shell.notify_rx();
+
+    auto replies = responses(serial.ostream.str());
+    REQUIRE(replies.size() == 1);
+    CHECK(replies[0].seq == 2);
+}
+
+TEST_CASE("frames holding packets longer than frame_size are dropped", "[shell][framing]") {
+    mock_serial serial;
+    framed_shell_t shell{serial, test_commands};
+    // The sequence ID, two length bytes and the CRC fill the rest of the packet
+    serial.istream << request_frame(1, {"cmd_a", std::string(54, 'x')})
+                   << request_frame(2, {"cmd_a", std::string(55, 'x')});
+    shell.notify_rx();
+
+    auto replies = responses(serial.ostream.str());
+    REQUIRE(replies.size() == 1);
+    CHECK(replies[0].seq == 1);
+}
+
+TEST_CASE("a stray zero byte only swallows the chars that would fit in a frame", "[shell][framing]") {
+    mock_serial serial;
+    framed_shell_t shell{serial, test_commands};
+    serial.istream << "\0"s << std::string(hh::shell::cobs_max_encoded_size(64), 'x') << "cmd_a";
+    shell.notify_rx();
+
+    CHECK(shell.current_line() == "cmd_a");
+}
+
+TEST_CASE("frames received while pasting are not pasted into the line", "[shell][framing][paste]") {
+    mock_bulk_serial serial;
+    hh::shell::shell<mock_bulk_serial, 10, 64, framed_config> shell{serial, test_commands};
+    serial.istream << "\x1b[200~ab" << request_frame(1, {"cmd_a", "yz"}) << "cd";
+    shell.notify_rx();
+
+    auto replies = responses(serial.ostream.str());
+    REQUIRE(replies.size() == 1);
+    CHECK(lastArgs == std::vector<std::string>{"cmd_a", "yz"});
+    CHECK(shell.current_line() == "abcd");
+}
+
+TEST_CASE("the first frame turns off bracketed paste in the terminal", "[shell][framing][paste]") {
+    mock_serial serial;
+    framed_shell_t shell{serial, test_commands};
+    shell.notify_connected();
+    serial.ostream.str("");
+    serial.istream << request_frame(1, {"cmd_a"}) << request_frame(2, {"cmd_a"});
+    shell.notify_rx();
+
+    auto output = serial.ostream.str();
+    CHECK(output.starts_with("\x1b[?2004l\0"s));
+    CHECK(output.find("\x1b[?2004l", 1) == std::string::npos);
+    CHECK(responses(output).size() == 2);
+}
+
+namespace {
+    struct framed_flow_control_config : flow_control_config {
+        static constexpr std::size_t frame_size = 64;
+    };
+}// namespace
+
+TEST_CASE("XON and XOFF bytes inside a frame are part of the packet", "[shell][framing][flow_control]") {
+    mock_nonblocking_serial serial;
+    hh::shell::shell<mock_nonblocking_serial, 10, 64, framed_flow_control_config> shell{serial, test_commands};
+    serial.istream << request_frame(0x11, {"cmd_a", "\x13\x11"}) << request_frame(0x13, {"cmd_a"});
+    shell.notify_rx();
+
+    auto replies = responses(serial.ostream.str());
+    REQUIRE(replies.size() == 2);
+    CHECK(replies[0].seq == 0x11);
+    CHECK(replies[1].seq == 0x13);
+    CHECK(lastArgs == std::vector<std::string>{"cmd_a"});
+}
+
+TEST_CASE("framed coroutine commands answer once finished, and requests meanwhile are busy", "[shell][framing]") {
+    mock_serial serial;
+    framed_shell_t shell{serial, test_commands};
+    serial.istream << request_frame(1, {"slow", "arg"});
+    shell.notify_rx();
+    CHECK(serial.ostream.str().empty());
+
+    serial.istream.clear();
+    serial.istream << request_frame(2, {"cmd_a"});
+    shell.notify_rx();
+    auto replies = responses(serial.ostream.str());
+    REQUIRE(replies.size() == 1);
+    CHECK(replies[0].seq == 2);
+    CHECK(replies[0].status == hh::shell::status_busy);
+
+    serial.ostream.str("");
+    shell.notify_tick();
+    shell.notify_tick();
+    shell.notify_tx_ready();
+    replies = responses(serial.ostream.str());
+    REQUIRE(replies.size() == 1);
+    CHECK(replies[0].seq == 1);
+    // Framed commands read end_of_input, as they have no terminal
+    CHECK(replies[0].output == "started waiting arg\xff");
+}
+
+TEST_CASE("lines tagged with a sequence id report their status with it", "[shell][sequence_id]") {
+    mock_serial serial;
+    shell_test_t shell{serial, test_commands};
+    serial.istream << "#12 cmd_b x\n#x cmd_a\n#13\n";
+    shell.notify();
+
+    CHECK(serial.ostream.str() == "#12 cmd_b x\n\rb ran with 2 args\n\r#12=0\n\r>"
+                                  "#x cmd_a\n\rinvalid sequence id\n\r>"
+                                  "#13\n\r#13=0\n\r>");
+    CHECK(lastArgs == std::vector<std::string>{"cmd_b", "x"});
+}
+
+namespace {
+    struct queued_config : hh::shell::shell_config {
+        static constexpr std::size_t line_queue_size = 32;
+    };
+}// namespace
+
+TEST_CASE("lines received while a command runs are queued and run in order", "[shell][sequence_id]") {
+    mock_serial serial;
+    hh::shell::shell<mock_serial, 10, 64, queued_config> shell{serial, test_commands};
+    shell.set_batch_mode(true);
+
+    serial.istream << "#1 slow arg\nz#2 cmd_b\n#3 nope\n";
+    shell.notify_rx();
+    CHECK(serial.ostream.str() == "started ");
+
+    shell.notify_tick();
+    shell.notify_tick();
+    shell.notify_tx_ready();
+    CHECK(serial.ostream.str() == "started waiting argz#1=0\n\r"
+                                  "b ran with 1 args\n\r#2=0\n\r"
+                                  "unknown command: nope\n\r#3=-1\n\r");
+}
+
+TEST_CASE("Ctrl-C cancels the command and discards chars typed ahead", "[shell][sequence_id]") {
+    mock_serial serial;
+    hh::shell::shell<mock_serial, 10, 64, queued_config> shell{serial, test_commands};
+    serial.istream << "slow arg\n";
+    shell.notify_rx();
+    shell.notify_tick();
+
+    serial.istream.clear();
+    serial.istream << "x\x03" << "cmd_a\n";
+    shell.notify_rx();
+    CHECK(serial.ostream.str() == "slow arg\n\rstarted ^C\n\r>cmd_a\n\r>");
+}
+
+TEST_CASE("a line that does not fit in the queue is dropped whole and reported by its id", "[shell][sequence_id]") {
+    mock_serial serial;
+    hh::shell::shell<mock_serial, 10, 64, queued_config> shell{serial, test_commands};
+    serial.istream << "slow arg\n";
+    shell.notify_rx();
+    serial.ostream.str("");
+
+    // The queue fills part way through the second line, which is still being received when the command ends
+    serial.istream.clear();
+    serial.istream << "z#1 cmd_a\n#2 cmd_b 0123456789abcdef";
+    shell.notify_rx();
+    lastCmd = 0;
+    shell.notify_tick();
+    shell.notify_tick();
+    shell.notify_tx_ready();
+    CHECK(serial.ostream.str() == "waiting argz>#1 cmd_a\n\r#1=0\n\r>");
+    CHECK(lastCmd == 1);
+
+    serial.ostream.str("");
+    serial.istream.clear();
+    serial.istream << "gh\n#3 cmd_b\n";
+    shell.notify_rx();
+    CHECK(serial.ostream.str() == "\r\x1b[2Kinput dropped, the line queue is full\n\r#2=-5\n\r>"
+                                  "#3 cmd_b\n\rb ran with 1 args\n\r#3=0\n\r>");
+    CHECK(lastArgs == std::vector<std::string>{"cmd_b"});
+}
+
+namespace {
+    struct search_config : hh::shell::shell_config {
+        static constexpr bool history_search = true;
+    };
+
+    struct search_shell : public hh::shell::shell<mock_serial, 10, 64, search_config> {
+        using shell::shell;
+        void notify() { notify_rx(); }
+    };
+}// namespace
+
+SCENARIO("Ctrl-R searches the history as the query is typed", "[shell][search]") {
+    GIVEN("a shell with some history") {
+        mock_serial serial;
+        search_shell shell{serial, test_commands};
+        serial.istream << "cmd_b on\ncmd_a x\ncmd_b off\nab";
+        shell.notify();
+        serial.ostream.str("");
+        serial.istream.clear();
+
+        WHEN("a query is typed after Ctrl-R") {
+            serial.istream << "\x12" << "b o";
+            shell.notify();
+
+            THEN("the newest match is shown after the query") {
+                CHECK(serial.ostream.str() == "\b\b(search)'b o': cmd_b off\x1b[12D");
+                CHECK(shell.current_line() == "ab");
+            }
+
+            AND_WHEN("the query is narrowed so the match is still shown") {
+                serial.ostream.str("");
+                serial.istream.clear();
+                serial.istream << "f";
+                shell.notify();
+                THEN("only the query char is inserted") {
+                    CHECK(serial.ostream.str() == "\x1b[@f");
+                }
+            }
+
+            AND_WHEN("Ctrl-R is pressed again and the match accepted with enter") {
+                serial.istream.clear();
+                serial.istream << "\x12\n";
+                shell.notify();
+                THEN("the older match is run") {
+                    CHECK(lastCmd == 2);
+                    CHECK(lastArgs == std::vector<std::string>{"cmd_b", "on"});
+                }
+            }
+
+            AND_WHEN("the query stops matching") {
+                serial.istream.clear();
+                serial.istream << "z";
+                shell.notify();
+                THEN("the search fails, and deleting the char finds the match again") {
+                    CHECK(serial.ostream.str().find("failed sear") != std::string::npos);
+                    serial.istream.clear();
+                    serial.istream << "\b\n";
+                    shell.notify();
+                    CHECK(lastArgs == std::vector<std::string>{"cmd_b", "off"});
+                }
+            }
+
+            AND_WHEN("there is no older match, and the query is narrowed so the match is still shown") {
+                serial.istream.clear();
+                serial.istream << "\x12\x12";
+                shell.notify();
+                CHECK(serial.ostream.str().find("failed sear") != std::string::npos);
+                serial.ostream.str("");
+                serial.istream.clear();
+                serial.istream << "n";
+                shell.notify();
+                THEN("the search succeeds again") {
+                    // "(failed search)'b o': cmd_b on" is redrawn as "(search)'b on': cmd_b on"
+                    CHECK(serial.ostream.str() == "\x1b[18Dsearch)'b on\x1b[6P");
+                }
+            }
+
+            AND_WHEN("the search is cancelled") {
+                serial.istream.clear();
+                serial.istream << "\x03";
+                shell.notify();
+                THEN("the line being typed is shown again") {
+                    CHECK(serial.ostream.str().ends_with("ab\x1b[K"));
+                    CHECK(shell.current_line() == "ab");
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Ctrl-R is ignored without history search", "[shell][search]") {
+    mock_serial serial;
+    shell_test_t shell{serial};
+
+    serial.istream << "ab\x12" << "c";
+    shell.notify();
+
+    CHECK(shell.current_line() == "abc");
+    CHECK(serial.ostream.str() == "abc");
+}
+
+namespace {
+    struct page_storage {
+        std::vector<std::string> pages = std::vector<std::string>(2, std::string(64, '\xff'));
+
+        [[nodiscard]] std::size_t page_size() const { return 64; }
+        [[nodiscard]] std::size_t page_count() const { return pages.size(); }
+        void read(std::size_t page, std::size_t offset, std::span<char> out) {
+            std::copy_n(pages[page].begin() + static_cast<std::ptrdiff_t>(offset), out.size(), out.begin());
+        }
+        void program(std::size_t page, std::size_t offset, std::span<const char> in) {
+            std::copy(in.begin(), in.end(), pages[page].begin() + static_cast<std::ptrdiff_t>(offset));
+        }
+        void erase(std::size_t page) { pages[page].assign(64, '\xff'); }
+    };
+
+    struct persistent_config : hh::shell::shell_config {
+        using history_storage = page_storage;
+    };
+    using persistent_shell = hh::shell::shell<mock_serial, 10, 64, persistent_config>;
+}// namespace
+
+TEST_CASE("the history is logged to storage and rebuilt from it after a reset", "[shell][history_log]") {
+    page_storage storage;
+    {
+        mock_serial serial;
+        persistent_shell shell{serial, test_commands};
+        persistent_shell::history_log_type log{storage};
+        shell.set_history_log(log);
+        serial.istream << "cmd_a x\ncmd_b on\ncmd_b on\n";
+        shell.notify_rx();
+        shell.flush_history();
+    }
+
+    mock_serial serial;
+    persistent_shell shell{serial, test_commands};
+    persistent_shell::history_log_type log{storage};
+    shell.set_history_log(log);
+    serial.istream << "\x1b[A\x1b[A";
+    shell.notify_rx();
+    CHECK(shell.current_line() == "cmd_a x");
+
+    // Repeating the newest line is not logged again
+    std::size_t lines = 0;
+    log.replay([&](std::string_view) { ++lines; });
+    CHECK(lines == 2);
+}
+
+namespace {
+    struct expansion_config : hh::shell::shell_config {
+        static constexpr bool history_expansion = true;
+    };
+    using expansion_shell = hh::shell::shell<mock_serial, 10, 64, expansion_config>;
+}// namespace
+
+SCENARIO("history lines are recalled with !", "[shell][history_expansion]") {
+    GIVEN("a shell with some history") {
+        mock_serial serial;
+        expansion_shell shell{serial, test_commands};
+        serial.istream << "cmd_b on\ncmd_a x\ncmd_b off\n";
+        shell.notify_rx();
+        serial.ostream.str("");
+        serial.istream.clear();
+
+        WHEN("the previous line is recalled with !!") {
+            serial.istream << "!! y\n";
+            shell.notify_rx();
+            THEN("it is shown and run with the rest of the line") {
+                CHECK(serial.ostream.str().find("\n\rcmd_b off y\n\r") != std::string::npos);
+                CHECK(lastArgs == std::vector<std::string>{"cmd_b", "off", "y"});
+            }
+        }
+
+        WHEN("lines are recalled by number") {
+            serial.istream << "!1\n";
+            shell.notify_rx();
+            CHECK(lastArgs == std::vector<std::string>{"cmd_b", "on"});
+            serial.istream.clear();
+            serial.istream << "!-3\n";
+            shell.notify_rx();
+            CHECK(lastArgs == std::vector<std::string>{"cmd_a", "x"});
+            // Running a line again moves it to a new number, and its old number is not found
+            serial.istream.clear();
+            serial.istream << "!-4\n";
+            shell.notify_rx();
+            CHECK(serial.ostream.str().find("!-4: event not found") != std::string::npos);
+        }
+
+        WHEN("a line is recalled by a prefix") {
+            serial.istream << "!cmd_b\n";
+            shell.notify_rx();
+            CHECK(lastArgs == std::vector<std::string>{"cmd_b", "off"});
+        }
+
+        WHEN("no line matches") {
+            lastCmd = 0;
+            serial.istream << "!9\n";
+            shell.notify_rx();
+            THEN("nothing is run") {
+                CHECK(serial.ostream.str().find("!9: event not found") != std::string::npos);
+                CHECK(lastCmd == 0);
+            }
+        }
+
+        WHEN("the history is listed") {
+            serial.istream << "history\n";
+            shell.notify_rx();
+            THEN("each line is numbered from the oldest") {
+                CHECK(serial.ostream.str().find("1  cmd_b on\n\r2  cmd_a x\n\r3  cmd_b off\n\r4  history\n\r") !=
+                      std::string::npos);
+            }
+        }
+    }
+}
+
+namespace {
+    using uart = hh::shell::serial_queue<16, 64>;
+    static_assert(hh::shell::serial_bulk_in_device<uart>);
+    static_assert(hh::shell::serial_nonblocking_out_device<uart>);
+
+    int txStarts = 0;
+}// namespace
+
+TEST_CASE("shells run over queues filled and drained by UART interrupts", "[shell][serial_queue]") {
+    uart::rx_queue rx;
+    uart::tx_queue tx;
+    uart serial{rx, tx, [] { ++txStarts; }};
+    hh::shell::shell<uart, 10, 64> shell{serial, test_commands};
+
+    // As the receive interrupt would, one char at a time
+    for (char ch : "cmd_a x\n"s.substr(0, 8)) { rx.push(ch); }
+    shell.notify_rx();
+    CHECK(lastArgs == std::vector<std::string>{"cmd_a", "x"});
+    CHECK(rx.empty());
+    CHECK(txStarts > 0);
+
+    // As the transmit interrupt would, a contiguous block at a time
+    std::string sent;
+    while (!tx.empty()) {
+        auto block = tx.front_segment();
+        sent.append(block.data(), block.size());
+        tx.consume(block.size());
+    }
+    CHECK(sent.starts_with("cmd_a x\n\r"));
+    CHECK(sent.ends_with(">"));
+}
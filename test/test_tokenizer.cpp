@@ -0,0 +1,96 @@
+/// \file test_tokenizer.cpp
+/// \brief Tests for splitting command lines into arguments
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <hh/tokenizer.hpp>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace std::string_literals;
+using status = hh::shell::tokenize_result::status;
+
+namespace {
+    std::vector<std::string> to_vector(std::span<std::string_view> args) {
+        return {args.begin(), args.end()};
+    }
+}// namespace
+
+TEST_CASE("lines are split into whitespace separated arguments", "[tokenizer]") {
+    auto [line, expected] = GENERATE(
+            std::tuple{""s, std::vector<std::string>{}},
+            std::tuple{"   "s, std::vector<std::string>{}},
+            std::tuple{"cmd"s, std::vector{"cmd"s}},
+            std::tuple{"cmd a bc"s, std::vector{"cmd"s, "a"s, "bc"s}},
+            std::tuple{"\t cmd  \ta  "s, std::vector{"cmd"s, "a"s}});
+
+    CAPTURE(line);
+    std::string_view args[4];
+    auto result = hh::shell::tokenize(line.data(), line.data() + line.size(), args);
+
+    CHECK(result.good());
+    CHECK(to_vector({args, result.argc}) == expected);
+}
+
+TEST_CASE("quotes and escapes are removed from arguments", "[tokenizer]") {
+    auto [line, expected] = GENERATE(
+            std::tuple{"echo 'a b'"s, std::vector{"echo"s, "a b"s}},
+            std::tuple{"echo \"a b\""s, std::vector{"echo"s, "a b"s}},
+            std::tuple{"echo a' 'b\"c d\""s, std::vector{"echo"s, "a bc d"s}},
+            std::tuple{"echo ''"s, std::vector{"echo"s, ""s}},
+            std::tuple{"echo a\\ b"s, std::vector{"echo"s, "a b"s}},
+            std::tuple{"echo \\'a"s, std::vector{"echo"s, "'a"s}},
+            std::tuple{"echo \"\\\"a\\\\\""s, std::vector{"echo"s, "\"a\\"s}},
+            std::tuple{"echo '\\n'"s, std::vector{"echo"s, "\\n"s}},
+            std::tuple{"echo \"\\n\""s, std::vector{"echo"s, "\\n"s}});
+
+    CAPTURE(line);
+    std::string_view args[4];
+    auto result = hh::shell::tokenize(line.data(), line.data() + line.size(), args);
+
+    CHECK(result.good());
+    CHECK(to_vector({args, result.argc}) == expected);
+}
+
+TEST_CASE("arguments are views into the tokenized line", "[tokenizer]") {
+    std::string line{"cmd \"quoted arg\" x"};
+    std::string_view args[4];
+    auto result = hh::shell::tokenize(line.data(), line.data() + line.size(), args);
+
+    REQUIRE(result.argc == 3);
+    for (std::size_t i = 0; i < result.argc; ++i) {
+        CHECK(args[i].data() >= line.data());
+        CHECK(args[i].data() + args[i].size() <= line.data() + line.size());
+    }
+}
+
+TEST_CASE("arguments with quotes or escapes are marked, so they can be told apart from operators", "[tokenizer]") {
+    std::string line{"a | '|' \\| \"\""};
+    std::string_view args[5];
+    bool quoted[5]{};
+    auto result = hh::shell::tokenize(line.data(), line.data() + line.size(), args, quoted);
+
+    REQUIRE(result.argc == 5);
+    CHECK(to_vector({args, result.argc}) == std::vector{"a"s, "|"s, "|"s, "|"s, ""s});
+    CHECK_FALSE(quoted[0]);
+    CHECK_FALSE(quoted[1]);
+    CHECK(quoted[2]);
+    CHECK(quoted[3]);
+    CHECK(quoted[4]);
+}
+
+TEST_CASE("lines that cannot be tokenized report an error", "[tokenizer]") {
+    auto [line, expected] = GENERATE(
+            std::tuple{"echo 'abc"s, status::unterminated_quote},
+            std::tuple{"echo \"abc\\\""s, status::unterminated_quote},
+            std::tuple{"a b c d e"s, status::too_many_args});
+
+    CAPTURE(line);
+    std::string_view args[4];
+    auto result = hh::shell::tokenize(line.data(), line.data() + line.size(), args);
+
+    CHECK(!result.good());
+    CHECK(result.result == expected);
+}
@@ -0,0 +1,128 @@
+/// \file test_tx_ring.cpp
+/// \brief Tests for non-blocking output buffering with flow control
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <hh/mini_stream.hpp>
+#include <hh/tx_ring.hpp>
+#include <string>
+#include <vector>
+
+namespace {
+    /// Accepts at most `space` chars until more is made available
+    struct mock_nonblocking_output {
+        std::string sent{};
+        std::vector<std::size_t> writes{};
+        std::size_t space{0};
+
+        std::size_t try_write(const char *s, std::size_t count) {
+            auto n = std::min(count, space);
+            sent.append(s, n);
+            space -= n;
+            writes.push_back(n);
+            return n;
+        }
+        void write(const char *s, std::size_t count) { sent.append(s, count); }
+        void flush() {}
+    };
+}// namespace
+
+SCENARIO("output is held in the ring until the device can accept it") {
+    GIVEN("a ring in front of a device with no space") {
+        mock_nonblocking_output out;
+        hh::shell::tx_ring<mock_nonblocking_output, 8, 6> ring{out};
+
+        WHEN("chars are written and sent") {
+            CHECK(ring.write("abcd", 4) == 4);
+            ring.send();
+            THEN("they stay buffered") {
+                CHECK(out.sent.empty());
+                CHECK(ring.size() == 4);
+                CHECK_FALSE(ring.would_block());
+            }
+
+            AND_WHEN("the device makes space for some of them") {
+                out.space = 3;
+                ring.send();
+                THEN("only what fits is sent") {
+                    CHECK(out.sent == "abc");
+                    CHECK(ring.size() == 1);
+                }
+            }
+        }
+
+        WHEN("the ring fills to the high water mark") {
+            ring.write("abcdef", 6);
+            THEN("writers would block") { CHECK(ring.would_block()); }
+        }
+
+        WHEN("more is written than the ring holds") {
+            THEN("the write is cut short") {
+                CHECK(ring.write("abcdefghij", 10) == 8);
+                CHECK(ring.size() == 8);
+            }
+        }
+    }
+
+    GIVEN("buffered output that wraps around the end of the ring") {
+        mock_nonblocking_output out;
+        hh::shell::tx_ring<mock_nonblocking_output, 8> ring{out};
+        out.space = 6;
+        ring.write("abcdef", 6);
+        ring.send();
+        ring.write("ghijk", 5);
+
+        WHEN("the device has space for all of it") {
+            out.space = 100;
+            out.writes.clear();
+            ring.send();
+            THEN("it is sent in order with one write per contiguous segment") {
+                CHECK(out.sent == "abcdefghijk");
+                CHECK(out.writes == std::vector<std::size_t>{2, 3});
+                CHECK(ring.empty());
+            }
+        }
+    }
+}
+
+SCENARIO("output can be paused") {
+    GIVEN("a paused ring with buffered output") {
+        mock_nonblocking_output out;
+        out.space = 100;
+        hh::shell::tx_ring<mock_nonblocking_output, 8> ring{out};
+        ring.pause();
+        ring.write("ab", 2);
+        ring.send();
+
+        THEN("nothing is sent and writers would block") {
+            CHECK(out.sent.empty());
+            CHECK(ring.paused());
+            CHECK(ring.would_block());
+        }
+
+        WHEN("output is resumed") {
+            ring.resume();
+            ring.send();
+            THEN("the buffered output is sent") {
+                CHECK(out.sent == "ab");
+                CHECK_FALSE(ring.would_block());
+            }
+        }
+    }
+}
+
+TEST_CASE("streams report writes cut short by a full ring") {
+    mock_nonblocking_output out;
+    hh::shell::tx_ring<mock_nonblocking_output, 4> ring{out};
+    hh::shell::oserial_stream stream{ring};
+
+    stream << "abc";
+    CHECK(stream.good());
+    stream << "de";
+    CHECK(stream.bad());
+    CHECK(ring.size() == 4);
+
+    stream.clear();
+    CHECK(stream.good());
+}
@@ -0,0 +1,131 @@
+/// \file test_typed_command.cpp
+/// \brief Tests for commands with typed parameters
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <hh/typed_command.hpp>
+#include <string>
+#include <vector>
+
+using namespace std::string_literals;
+using hh::shell::cmd_ostream;
+using hh::shell::in_range;
+
+namespace {
+    enum class color { red, green, blue };
+}// namespace
+
+template<>
+struct hh::shell::enum_names<color> {
+    static constexpr std::pair<std::string_view, color> values[] = {
+            {"red", color::red},
+            {"green", color::green},
+            {"blue", color::blue},
+    };
+};
+
+namespace {
+    struct mock_output {
+        std::string written{};
+        void write(const char *s, std::size_t count) { written.append(s, count); }
+        void flush() {}
+    };
+
+    struct led_call {
+        int idx{-1};
+        bool on{false};
+        color c{};
+        std::string name{};
+    };
+    led_call lastCall{};
+
+    int set_led(in_range<0, 7> idx, bool on, color c) {
+        lastCall = {idx, on, c, {}};
+        return 0;
+    }
+
+    int rename_led(std::uint8_t idx, std::string_view name, cmd_ostream &out) {
+        lastCall = {idx, false, {}, std::string{name}};
+        out << "renamed";
+        return 1;
+    }
+
+    int ping() { return 7; }
+
+    int run(hh::shell::command::cmd_function *fn, std::vector<std::string_view> argv, std::string &output) {
+        mock_output device;
+        hh::shell::output_sink sink{device};
+        cmd_ostream out{sink};
+        auto result = fn(argv, out);
+        output = device.written;
+        return result;
+    }
+
+    template<class T>
+    bool parse(std::string_view arg, T &value) {
+        return hh::shell::arg_parser<T>::parse(arg, value);
+    }
+}// namespace
+
+TEST_CASE("typed commands are called with their parsed arguments", "[typed_command]") {
+    std::string output;
+    lastCall = {};
+
+    CHECK(run(hh::shell::typed_command<set_led>, {"led", "5", "on", "blue"}, output) == 0);
+    CHECK(lastCall.idx == 5);
+    CHECK(lastCall.on);
+    CHECK(lastCall.c == color::blue);
+    CHECK(output.empty());
+
+    CHECK(run(hh::shell::typed_command<rename_led>, {"rename", "0x10", "front"}, output) == 1);
+    CHECK(lastCall.idx == 16);
+    CHECK(lastCall.name == "front");
+    CHECK(output == "renamed");
+
+    CHECK(run(hh::shell::typed_command<ping>, {"ping"}, output) == 7);
+}
+
+TEST_CASE("typed commands are not called with bad arguments", "[typed_command]") {
+    auto [argv, message] = GENERATE(
+            std::tuple{std::vector<std::string_view>{"led", "1", "on"}, "expected 3 arguments\n\r"s},
+            std::tuple{std::vector<std::string_view>{"led", "8", "on", "red"}, "invalid argument: 8\n\r"s},
+            std::tuple{std::vector<std::string_view>{"led", "1", "maybe", "red"}, "invalid argument: maybe\n\r"s},
+            std::tuple{std::vector<std::string_view>{"led", "1", "on", "pink"}, "invalid argument: pink\n\r"s});
+
+    std::string output;
+    lastCall = {};
+    CHECK(run(hh::shell::typed_command<set_led>, argv, output) == hh::shell::status_bad_arguments);
+    CHECK(output == message);
+    CHECK(lastCall.idx == -1);
+}
+
+TEST_CASE("integer arguments must fit their type", "[typed_command]") {
+    std::int8_t i8{};
+    CHECK(parse("-128", i8));
+    CHECK(i8 == -128);
+    CHECK(parse("127", i8));
+    CHECK(i8 == 127);
+    CHECK_FALSE(parse("128", i8));
+    CHECK_FALSE(parse("-129", i8));
+
+    std::uint16_t u16{};
+    CHECK(parse("0xffFF", u16));
+    CHECK(u16 == 0xffff);
+    CHECK_FALSE(parse("65536", u16));
+    CHECK_FALSE(parse("-1", u16));
+    CHECK_FALSE(parse("0x", u16));
+    CHECK_FALSE(parse("", u16));
+    CHECK_FALSE(parse("12a", u16));
+
+    std::int32_t i32{};
+    CHECK(parse("-2147483648", i32));
+    CHECK(i32 == INT32_MIN);
+    CHECK_FALSE(parse("4294967296", i32));
+
+    in_range<-5, 5> r{};
+    CHECK(parse("-5", r));
+    CHECK(r == -5);
+    CHECK_FALSE(parse("-6", r));
+    CHECK_FALSE(parse("6", r));
+}
@@ -0,0 +1,143 @@
+/// \file test_write_buffer.cpp
+/// \brief Tests for coalescing writes to serial output devices
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <hh/write_buffer.hpp>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+    struct mock_output {
+        std::vector<std::string> writes{};
+        std::size_t numFlushes{0};
+        void write(const char *s, std::size_t count) { writes.emplace_back(s, count); }
+        void flush() { ++numFlushes; }
+    };
+}// namespace
+
+SCENARIO("small writes are coalesced into a single device write") {
+    GIVEN("an empty write buffer") {
+        mock_output out;
+        hh::shell::write_buffer<mock_output, 8> buffer{out};
+        CHECK(buffer.empty());
+
+        WHEN("writes smaller than the buffer are made") {
+            buffer.write("ab", 2);
+            buffer.write("c", 1);
+            buffer.write("def", 3);
+
+            THEN("nothing is written to the device") {
+                CHECK(out.writes.empty());
+                CHECK(buffer.size() == 6);
+            }
+
+            AND_WHEN("send is called") {
+                buffer.send();
+                THEN("the buffered chars are written in one write") {
+                    CHECK(out.writes == std::vector<std::string>{"abcdef"});
+                    CHECK(buffer.empty());
+                    CHECK(out.numFlushes == 0);
+                }
+            }
+
+            AND_WHEN("flush is called") {
+                buffer.flush();
+                THEN("the buffered chars are written and the device is flushed") {
+                    CHECK(out.writes == std::vector<std::string>{"abcdef"});
+                    CHECK(out.numFlushes == 1);
+                }
+            }
+
+            AND_WHEN("a write overfills the buffer") {
+                buffer.write("ghijk", 5);
+                THEN("the full buffer is written and the rest of the chars stay buffered") {
+                    CHECK(out.writes == std::vector<std::string>{"abcdefgh"});
+                    CHECK(buffer.size() == 3);
+                }
+            }
+        }
+
+        WHEN("a write at least as large as the buffer is made") {
+            buffer.write("0123456789", 10);
+            THEN("it is passed directly to the device") {
+                CHECK(out.writes == std::vector<std::string>{"0123456789"});
+                CHECK(buffer.empty());
+            }
+        }
+
+        WHEN("send is called") {
+            buffer.send();
+            THEN("nothing is written to the device") {
+                CHECK(out.writes.empty());
+            }
+        }
+    }
+}
+
+namespace {
+    struct tracking_lock {
+        bool *held;
+        int *locks;
+        void lock() {
+            *held = true;
+            ++*locks;
+        }
+        void unlock() { *held = false; }
+    };
+
+    struct locked_output {
+        bool *held;
+        std::size_t unlockedWrites{0};
+        void write(const char *, std::size_t) {
+            if (!*held) { ++unlockedWrites; }
+        }
+        void flush() {
+            if (!*held) { ++unlockedWrites; }
+        }
+    };
+}// namespace
+
+TEST_CASE("the lock is held from the first device write of a message until it is sent", "[write_buffer][lock]") {
+    bool held = false;
+    int locks = 0;
+    tracking_lock lock{&held, &locks};
+    locked_output out{&held};
+    hh::shell::write_buffer<locked_output, 8, tracking_lock> buffer{out, lock};
+
+    buffer.write("abc", 3);
+    buffer.write("def", 3);
+    CHECK(locks == 0);
+    buffer.send();
+    CHECK(locks == 1);
+    CHECK_FALSE(held);
+
+    // A message larger than the buffer is written in parts, without letting other writers in between
+    buffer.write("a longer", 8);
+    buffer.write(" message", 8);
+    buffer.write("!", 1);
+    CHECK(locks == 2);
+    CHECK(held);
+    buffer.send();
+    CHECK(locks == 2);
+    CHECK_FALSE(held);
+
+    buffer.write("abc", 3);
+    buffer.flush();
+    CHECK(locks == 3);
+    CHECK(out.unlockedWrites == 0);
+    CHECK_FALSE(held);
+}
+
+TEST_CASE("locks that cannot be copied are held by reference", "[write_buffer][lock]") {
+    std::mutex mutex;
+    mock_output out;
+    hh::shell::write_buffer<mock_output, 4, std::mutex> buffer{out, mutex};
+
+    buffer.write("abcdef", 6);
+    CHECK_FALSE(mutex.try_lock());
+    buffer.send();
+    REQUIRE(mutex.try_lock());
+    mutex.unlock();
+}